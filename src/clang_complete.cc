@@ -16,6 +16,7 @@ using namespace clang;
 using namespace llvm;
 
 #include <algorithm>
+#include <chrono>
 #include <thread>
 
 namespace {
@@ -468,14 +469,47 @@ void CompletionQueryMain(ClangCompleteManager* completion_manager) {
   }
 }
 
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 void DiagnosticQueryMain(ClangCompleteManager *manager) {
+  // Reparses whose result was superseded by a newer edit before publishing.
+  int64_t discarded = 0, discarded_ms = 0;
   while (true) {
-    // Fetching the completion request blocks until we have a request.
-    ClangCompleteManager::DiagnosticRequest request =
-        manager->diagnostic_request_.Dequeue();
+    // Take the document whose debounce deadline comes first, once it has
+    // passed. DiagnosticsUpdate pushes the deadline back instead of adding
+    // another request, so there is one reparse per burst of edits, and wakes
+    // this thread when a document is added or its deadline moves.
+    std::string path;
+    int coalesced = 0;
+    {
+      std::unique_lock<std::mutex> lock(manager->diagnostics_lock_);
+      while (true) {
+        auto it = std::min_element(
+            manager->pending_diagnostics_.begin(),
+            manager->pending_diagnostics_.end(), [](auto &l, auto &r) {
+              return l.second.deadline < r.second.deadline;
+            });
+        if (it == manager->pending_diagnostics_.end()) {
+          manager->diagnostics_cv_.wait(lock);
+          continue;
+        }
+        int64_t wait = it->second.deadline - NowMs();
+        if (wait <= 0 || !g_config->diagnostics.onType) {
+          path = it->first;
+          coalesced = it->second.coalesced;
+          manager->pending_diagnostics_.erase(it);
+          break;
+        }
+        manager->diagnostics_cv_.wait_for(lock,
+                                          std::chrono::milliseconds(wait));
+      }
+    }
     if (!g_config->diagnostics.onType)
       continue;
-    std::string path = request.document.uri.GetPath();
 
     std::shared_ptr<CompletionSession> session = manager->TryGetSession(
         path, true /*mark_as_completion*/, true /*create_if_needed*/);
@@ -490,6 +524,9 @@ void DiagnosticQueryMain(ClangCompleteManager *manager) {
     if (!tu)
       continue;
 
+    // Take the snapshot after debouncing so that the reparse sees the latest
+    // buffer.
+    int64_t start = NowMs();
     WorkingFiles::Snapshot snapshot =
         manager->working_files_->AsSnapshot({StripFileType(path)});
     llvm::CrashRecoveryContext CRC;
@@ -498,6 +535,26 @@ void DiagnosticQueryMain(ClangCompleteManager *manager) {
                    << path;
       continue;
     }
+    int64_t elapsed = NowMs() - start;
+
+    // If the document was edited during the reparse, another request has been
+    // queued and these diagnostics are already stale.
+    bool superseded;
+    {
+      std::lock_guard<std::mutex> lock(manager->diagnostics_lock_);
+      superseded = manager->pending_diagnostics_.count(path);
+    }
+    if (superseded) {
+      discarded++;
+      discarded_ms += elapsed;
+      LOG_S(INFO) << "discard diagnostics for " << path << " (" << elapsed
+                  << "ms); " << discarded << " reparses (" << discarded_ms
+                  << "ms) discarded in total";
+      continue;
+    }
+    LOG_IF_S(INFO, coalesced)
+        << "reparse " << path << " for diagnostics in " << elapsed << "ms, "
+        << coalesced << " requests coalesced";
 
     auto &LangOpts = tu->Unit->getLangOpts();
     std::vector<lsDiagnostic> ls_diags;
@@ -588,15 +645,23 @@ void ClangCompleteManager::CodeComplete(
 }
 
 void ClangCompleteManager::DiagnosticsUpdate(
-    const lsTextDocumentIdentifier& document) {
-  bool has = false;
-  diagnostic_request_.Iterate([&](const DiagnosticRequest& request) {
-    if (request.document.uri == document.uri)
-      has = true;
-  });
-  if (!has)
-    diagnostic_request_.PushBack(DiagnosticRequest{document},
-                                 true /*priority*/);
+    const lsTextDocumentIdentifier& document,
+    bool debounce) {
+  int64_t deadline =
+      NowMs() + (debounce ? g_config->diagnostics.onTypeDebounceMs : 0);
+  {
+    std::lock_guard<std::mutex> lock(diagnostics_lock_);
+    auto [it, inserted] =
+        pending_diagnostics_.try_emplace(document.uri.GetPath());
+    if (!inserted) {
+      // Keep the earlier deadline of a non-debounced request (e.g. didOpen).
+      if (debounce)
+        it->second.deadline = std::max(it->second.deadline, deadline);
+      it->second.coalesced++;
+    } else
+      it->second.deadline = deadline;
+  }
+  diagnostics_cv_.notify_one();
 }
 
 void ClangCompleteManager::NotifyView(const std::string& filename) {
@@ -8,10 +8,12 @@
 #include "threaded_queue.h"
 #include "working_files.h"
 
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
 struct CompletionSession
     : public std::enable_shared_from_this<CompletionSession> {
@@ -66,9 +68,6 @@ struct ClangCompleteManager {
     lsPosition position;
     OnComplete on_complete;
   };
-  struct DiagnosticRequest {
-    lsTextDocumentIdentifier document;
-  };
 
   ClangCompleteManager(Project* project,
                        WorkingFiles* working_files,
@@ -80,8 +79,12 @@ struct ClangCompleteManager {
   void CodeComplete(const lsRequestId& request_id,
                     const lsTextDocumentPositionParams& completion_location,
                     const OnComplete& on_complete);
-  // Request a diagnostics update.
-  void DiagnosticsUpdate(const lsTextDocumentIdentifier& document);
+  // Request a diagnostics update. If |debounce| is true, the reparse is
+  // delayed until the document has not changed for
+  // |g_config->diagnostics.onTypeDebounceMs|. Requests for a document which
+  // already has a pending reparse are coalesced into it.
+  void DiagnosticsUpdate(const lsTextDocumentIdentifier& document,
+                         bool debounce);
 
   // Notify the completion manager that |filename| has been viewed and we
   // should begin preloading completion data.
@@ -133,7 +136,17 @@ struct ClangCompleteManager {
 
   // Request a code completion at the given location.
   ThreadedQueue<std::unique_ptr<CompletionRequest>> completion_request_;
-  ThreadedQueue<DiagnosticRequest> diagnostic_request_;
+  // Documents waiting for a diagnostics reparse. The value is the earliest
+  // time (in milliseconds) the reparse may start and the number of requests
+  // coalesced into it. Guarded by |diagnostics_lock_|. |diagnostics_cv_| is
+  // notified when an entry is added or its deadline changes.
+  struct PendingDiagnostic {
+    int64_t deadline = 0;
+    int coalesced = 0;
+  };
+  std::unordered_map<std::string, PendingDiagnostic> pending_diagnostics_;
+  std::mutex diagnostics_lock_;
+  std::condition_variable diagnostics_cv_;
   // Parse requests. The path may already be parsed, in which case it should be
   // reparsed.
   ThreadedQueue<PreloadRequest> preload_requests_;
@@ -53,23 +53,39 @@ Range FromTokenRange(const SourceManager &SM, const LangOptions &LangOpts,
   return FromSourceRange(SM, LangOpts, R, UniqueID, true);
 }
 
+namespace {
+// A MemoryBuffer which references the content of a WorkingFile version
+// instead of copying it. The content stays alive as long as clang holds the
+// buffer, even if the file is edited in the meantime.
+class SharedMemoryBuffer : public llvm::MemoryBuffer {
+  std::shared_ptr<const std::string> content;
+  std::string name;
+
+public:
+  SharedMemoryBuffer(std::shared_ptr<const std::string> content,
+                     const std::string &name)
+      : content(std::move(content)), name(name) {
+    init(this->content->data(), this->content->data() + this->content->size(),
+         /*RequiresNullTerminator=*/true);
+  }
+  StringRef getBufferIdentifier() const override { return name; }
+  BufferKind getBufferKind() const override { return MemoryBuffer_Malloc; }
+};
+} // namespace
+
 std::vector<ASTUnit::RemappedFile>
 GetRemapped(const WorkingFiles::Snapshot &snapshot) {
   std::vector<ASTUnit::RemappedFile> Remapped;
-  for (auto &file : snapshot.files) {
-    std::unique_ptr<llvm::MemoryBuffer> MB =
-        llvm::MemoryBuffer::getMemBufferCopy(file.content, file.filename);
-    Remapped.emplace_back(file.filename, MB.release());
-  }
+  for (auto &file : snapshot.files)
+    Remapped.emplace_back(file.filename,
+                          new SharedMemoryBuffer(file.content, file.filename));
   return Remapped;
 }
 
 std::unique_ptr<ClangTranslationUnit> ClangTranslationUnit::Create(
-    const std::string &filepath, const std::vector<std::string> &args,
+    const std::string &filepath, const ccls::CompileArgs &args,
     const WorkingFiles::Snapshot &snapshot, bool diagnostic) {
-  std::vector<const char *> Args;
-  for (auto& arg : args)
-    Args.push_back(arg.c_str());
+  std::vector<const char *> Args(args.begin(), args.end());
   Args.push_back("-fno-spell-checking");
   Args.push_back("-fallow-editor-placeholders");
 
@@ -24,7 +24,7 @@ Range FromTokenRange(const clang::SourceManager &SM, const clang::LangOptions &L
 
 struct ClangTranslationUnit {
   static std::unique_ptr<ClangTranslationUnit>
-  Create(const std::string &filepath, const std::vector<std::string> &args,
+  Create(const std::string &filepath, const ccls::CompileArgs &args,
          const WorkingFiles::Snapshot &snapshot, bool diagnostic);
 
   int Reparse(llvm::CrashRecoveryContext &CRC,
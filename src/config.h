@@ -61,6 +61,11 @@ struct Config {
   struct CodeLens {
     // Enables code lens on parameter and function variables.
     bool localVariables = true;
+
+    // If true, textDocument/codeLens only returns ranges, and titles and
+    // locations are computed on codeLens/resolve, which clients send for
+    // visible lenses.
+    bool resolve = true;
   } codeLens;
 
   struct Completion {
@@ -139,6 +144,11 @@ struct Config {
     // If true, diagnostics from typing will be reported.
     bool onType = true;
 
+    // How long (in milliseconds) a document must stay unchanged before it is
+    // reparsed for diagnostics on typing. didChange notifications arriving
+    // within the window are coalesced into one reparse of the latest buffer.
+    int onTypeDebounceMs = 200;
+
     std::vector<std::string> whitelist;
   } diagnostics;
 
@@ -169,6 +179,10 @@ struct Config {
     // `std::regex_search(path, regex, std::regex_constants::match_any)`
     //
     // Example: `ash/.*\.cc`
+    //
+    // Without compile_commands.json, if the whitelist is empty, directories
+    // (with a trailing slash) matching the blacklist are not traversed, e.g.
+    // `/(build|node_modules)/$`.
     std::vector<std::string> blacklist;
 
     // 0: none, 1: Doxygen, 2: all comments
@@ -192,6 +206,11 @@ struct Config {
     // Number of indexer threads. If 0, 80% of cores are used.
     int threads = 0;
 
+    // If true, watch directories of indexed files (Linux inotify) and reindex
+    // translation units whose dependencies change. For clients which do not
+    // send workspace/didChangeWatchedFiles.
+    bool watch = false;
+
     std::vector<std::string> whitelist;
   } index;
 
@@ -217,7 +236,7 @@ struct Config {
 };
 MAKE_REFLECT_STRUCT(Config::Clang, extraArgs, resourceDir);
 MAKE_REFLECT_STRUCT(Config::ClientCapability, snippetSupport);
-MAKE_REFLECT_STRUCT(Config::CodeLens, localVariables);
+MAKE_REFLECT_STRUCT(Config::CodeLens, localVariables, resolve);
 MAKE_REFLECT_STRUCT(Config::Completion,
                     caseSensitivity,
                     dropOldRequests,
@@ -232,6 +251,7 @@ MAKE_REFLECT_STRUCT(Config::Diagnostics,
                     frequencyMs,
                     onParse,
                     onType,
+                    onTypeDebounceMs,
                     whitelist)
 MAKE_REFLECT_STRUCT(Config::Highlight, lsRanges, blacklist, whitelist)
 MAKE_REFLECT_STRUCT(Config::Index,
@@ -242,6 +262,7 @@ MAKE_REFLECT_STRUCT(Config::Index,
                     onDidChange,
                     reparseForDependency,
                     threads,
+                    watch,
                     whitelist);
 MAKE_REFLECT_STRUCT(Config::WorkspaceSymbol, caseSensitivity, maxNum, sort);
 MAKE_REFLECT_STRUCT(Config::Xref, container, maxNum);
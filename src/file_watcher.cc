@@ -0,0 +1,154 @@
+#include "file_watcher.hh"
+
+#ifdef __linux__
+#include "log.hh"
+#include "pipeline.hh"
+#include "project.h"
+#include "utils.h"
+#include "working_files.h"
+
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Threading.h>
+using namespace llvm;
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ccls::watcher {
+namespace {
+// A batch ends after this long without events, or after kMaxBatchMs.
+const int kQuietMs = 200, kMaxBatchMs = 2000;
+
+int fd = -1;
+std::mutex mutex;
+std::unordered_map<int, std::string> wd2dir;
+std::unordered_set<std::string> watched;
+bool limit_reached = false;
+
+// Appends paths of changed files in events available on |fd|.
+void ReadEvents(std::unordered_set<std::string>* changed) {
+  alignas(inotify_event) char buf[65536];
+  ssize_t n = read(fd, buf, sizeof buf);
+  std::lock_guard<std::mutex> lock(mutex);
+  for (ssize_t i = 0; i < n;) {
+    auto* ev = reinterpret_cast<inotify_event*>(buf + i);
+    i += sizeof(inotify_event) + ev->len;
+    if (ev->mask & IN_IGNORED) {
+      auto it = wd2dir.find(ev->wd);
+      if (it != wd2dir.end()) {
+        watched.erase(it->second);
+        wd2dir.erase(it);
+      }
+      continue;
+    }
+    if (!ev->len || (ev->mask & IN_ISDIR))
+      continue;
+    auto it = wd2dir.find(ev->wd);
+    if (it != wd2dir.end())
+      changed->insert(it->second + ev->name);
+  }
+}
+
+void Dispatch(Project* project, WorkingFiles* wfiles,
+              const std::unordered_set<std::string>& changed) {
+  InvalidateWriteTimes();
+  std::unordered_set<int> ids;
+  {
+    std::lock_guard<std::mutex> lock(project->mutex_);
+    for (const std::string& path : changed) {
+      auto it = project->absolute_path_to_entry_index_.find(path);
+      if (it != project->absolute_path_to_entry_index_.end() &&
+          project->entries[it->second].filename == path)
+        ids.insert(it->second);
+      auto it1 = project->dependents_.find(path);
+      if (it1 != project->dependents_.end())
+        ids.insert(it1->second.begin(), it1->second.end());
+    }
+  }
+  if (ids.empty())
+    return;
+  LOG_S(INFO) << changed.size() << " changed files affect " << ids.size()
+              << " translation units";
+  for (int id : ids) {
+    Project::Entry entry;
+    {
+      std::lock_guard<std::mutex> lock(project->mutex_);
+      if (id >= (int)project->entries.size())
+        continue;
+      entry = project->entries[id];
+    }
+    bool is_interactive = wfiles->GetFileByFilename(entry.filename) != nullptr;
+    pipeline::Index(entry.filename, entry.args, is_interactive);
+  }
+}
+} // namespace
+
+void Start(Project* project, WorkingFiles* working_files) {
+  fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) {
+    LOG_S(WARNING) << "inotify_init1: " << strerror(errno);
+    return;
+  }
+  std::thread([=]() {
+    set_thread_name("watcher");
+    std::unordered_set<std::string> changed;
+    for (;;) {
+      ReadEvents(&changed);
+      // Coalesce bursts such as a branch switch into one batch.
+      auto deadline = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(kMaxBatchMs);
+      pollfd pfd{fd, POLLIN, 0};
+      for (;;) {
+        int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           deadline - std::chrono::steady_clock::now())
+                           .count();
+        int timeout = int(std::min<int64_t>(kQuietMs, left));
+        if (timeout <= 0 || poll(&pfd, 1, timeout) <= 0)
+          break;
+        ReadEvents(&changed);
+      }
+      Dispatch(project, working_files, changed);
+      changed.clear();
+    }
+  }).detach();
+}
+
+void Watch(const std::string& path) {
+  if (fd < 0)
+    return;
+  std::string dir = sys::path::parent_path(path).str();
+  dir += '/';
+  std::lock_guard<std::mutex> lock(mutex);
+  if (limit_reached || watched.count(dir))
+    return;
+  int wd = inotify_add_watch(fd, dir.c_str(),
+                             IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                 IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+  if (wd < 0) {
+    if (errno == ENOSPC) {
+      limit_reached = true;
+      LOG_S(WARNING) << "inotify watch limit reached; increase "
+                        "fs.inotify.max_user_watches";
+    }
+    return;
+  }
+  watched.insert(dir);
+  wd2dir[wd] = dir;
+}
+} // namespace ccls::watcher
+#else
+namespace ccls::watcher {
+void Start(Project*, WorkingFiles*) {}
+void Watch(const std::string&) {}
+} // namespace ccls::watcher
+#endif
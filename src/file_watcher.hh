@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+struct Project;
+struct WorkingFiles;
+
+namespace ccls::watcher {
+// Starts watching with inotify (Linux only, otherwise a no-op). Changes are
+// batched, mapped to the translation units depending on the changed files and
+// enqueued for indexing, once per translation unit per batch.
+void Start(Project* project, WorkingFiles* working_files);
+// Watches the directory containing |path|, if the watcher is running.
+void Watch(const std::string& path);
+} // namespace ccls::watcher
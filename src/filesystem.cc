@@ -1,9 +1,17 @@
 #include "filesystem.hh"
 using namespace llvm;
 
+#include "serializers/json.h"
 #include "utils.h"
 
+#include <llvm/Config/llvm-config.h>
+
+#include <rapidjson/writer.h>
+
+#include <condition_variable>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <vector>
 
 void GetFilesInFolder(std::string folder,
@@ -56,3 +64,146 @@ void GetFilesInFolder(std::string folder,
     }
   }
 }
+
+MAKE_REFLECT_STRUCT(DirListing, mtime, files, dirs);
+
+namespace {
+// Lists |dir|, or reuses its listing in |cache| if the mtime matches.
+bool ListDir(const std::string& dir, const DirListingCache& cache,
+             DirListing* listing, sys::fs::UniqueID* id) {
+  sys::fs::file_status Status;
+  if (sys::fs::status(dir, Status, true))
+    return false;
+  *id = Status.getUniqueID();
+  int64_t mtime = Status.getLastModificationTime().time_since_epoch().count();
+  auto it = cache.find(dir);
+  if (it != cache.end() && it->second.mtime == mtime) {
+    *listing = it->second;
+    return true;
+  }
+  listing->mtime = mtime;
+  std::error_code ec;
+  for (sys::fs::directory_iterator I(dir, ec, false), E; I != E && !ec;
+       I.increment(ec)) {
+    std::string path = I->path(), filename = sys::path::filename(path);
+    if (filename[0] == '.' && filename != ".ccls")
+      continue;
+    // The type from readdir avoids a stat for most entries.
+    sys::fs::file_type type = sys::fs::file_type::type_unknown;
+#if LLVM_VERSION_MAJOR >= 8
+    type = I->type();
+#endif
+    if (type == sys::fs::file_type::type_unknown ||
+        type == sys::fs::file_type::symlink_file) {
+      if (sys::fs::status(path, Status, true))
+        continue;
+      type = Status.type();
+    }
+    if (type == sys::fs::file_type::regular_file)
+      listing->files.push_back(std::move(filename));
+    else if (type == sys::fs::file_type::directory_file)
+      listing->dirs.push_back(std::move(filename));
+  }
+  return true;
+}
+} // namespace
+
+void WalkFolder(std::string folder, int threads,
+                const std::function<bool(const std::string&)>& skip,
+                const DirListingCache& cache, DirListingCache* visited,
+                const std::function<void(const std::string&)>& handler) {
+  EnsureEndsInSlash(folder);
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> queue{folder};
+  int busy = 0;
+  std::set<sys::fs::UniqueID> seen;
+
+  auto work = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cv.wait(lock, [&] { return queue.size() || !busy; });
+      if (queue.empty())
+        return;
+      std::string dir = std::move(queue.back());
+      queue.pop_back();
+      busy++;
+      lock.unlock();
+
+      DirListing listing;
+      sys::fs::UniqueID ID;
+      std::vector<std::string> subdirs;
+      bool ok = ListDir(dir, cache, &listing, &ID);
+      if (ok)
+        for (const std::string& name : listing.dirs) {
+          std::string subdir = dir + name + '/';
+          if (!skip(subdir))
+            subdirs.push_back(std::move(subdir));
+        }
+
+      lock.lock();
+      busy--;
+      if (ok && seen.insert(ID).second) {
+        for (const std::string& name : listing.files)
+          handler(dir + name);
+        for (std::string& subdir : subdirs)
+          queue.push_back(std::move(subdir));
+        (*visited)[std::move(dir)] = std::move(listing);
+      }
+      cv.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++)
+    workers.emplace_back(work);
+  work();
+  for (std::thread& worker : workers)
+    worker.join();
+}
+
+void WalkCachedFolder(std::string folder, const DirListingCache& cache,
+                      const std::function<void(const std::string&)>& handler) {
+  EnsureEndsInSlash(folder);
+  std::vector<std::string> stack{folder};
+  while (stack.size()) {
+    std::string dir = std::move(stack.back());
+    stack.pop_back();
+    auto it = cache.find(dir);
+    if (it == cache.end())
+      continue;
+    for (const std::string& name : it->second.files)
+      handler(dir + name);
+    for (const std::string& name : it->second.dirs)
+      stack.push_back(dir + name + '/');
+  }
+}
+
+void LoadDirListingCache(const std::string& path, DirListingCache* cache) {
+  std::optional<std::string> content = ReadContent(path);
+  if (!content)
+    return;
+  rapidjson::Document reader;
+  reader.Parse(content->c_str());
+  if (reader.HasParseError())
+    return;
+  std::vector<std::pair<std::string, DirListing>> listings;
+  JsonReader json_reader{&reader};
+  try {
+    Reflect(json_reader, listings);
+  } catch (std::invalid_argument&) {
+    return;
+  }
+  for (auto& it : listings)
+    cache->emplace(std::move(it.first), std::move(it.second));
+}
+
+void SaveDirListingCache(const std::string& path,
+                         const DirListingCache& cache) {
+  std::vector<std::pair<std::string, DirListing>> listings(cache.begin(),
+                                                           cache.end());
+  rapidjson::StringBuffer output;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(output);
+  JsonWriter json_writer(&writer);
+  Reflect(json_writer, listings);
+  WriteToFile(path, output.GetString());
+}
@@ -5,8 +5,40 @@
 
 #include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 void GetFilesInFolder(std::string folder,
                       bool recursive,
                       bool add_folder_to_path,
                       const std::function<void(const std::string&)>& handler);
+
+// Names of regular files and subdirectories of a directory, which stay valid
+// while its modification time is |mtime|.
+struct DirListing {
+  int64_t mtime = 0;
+  std::vector<std::string> files;
+  std::vector<std::string> dirs;
+};
+using DirListingCache = std::unordered_map<std::string, DirListing>;
+
+// Like GetFilesInFolder(folder, true, true, handler), but directories are
+// listed by |threads| threads. Subdirectories (ending with '/') for which
+// |skip| returns true are not visited. Listings in |cache| are reused for
+// directories whose mtime has not changed, and the listings of all visited
+// directories are added to |visited|. |handler| is not called concurrently.
+void WalkFolder(std::string folder, int threads,
+                const std::function<bool(const std::string&)>& skip,
+                const DirListingCache& cache, DirListingCache* visited,
+                const std::function<void(const std::string&)>& handler);
+
+// Like WalkFolder, but only reads listings in |cache| and does not access the
+// file system.
+void WalkCachedFolder(std::string folder, const DirListingCache& cache,
+                      const std::function<void(const std::string&)>& handler);
+
+// Persist a DirListingCache as JSON. A missing or malformed file is treated
+// as empty.
+void LoadDirListingCache(const std::string& path, DirListingCache* cache);
+void SaveDirListingCache(const std::string& path,
+                         const DirListingCache& cache);
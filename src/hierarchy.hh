@@ -0,0 +1,97 @@
+#pragma once
+
+#include "query_utils.h"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+namespace ccls {
+// Breadth-first expansion shared by $ccls/callHierarchy and
+// $ccls/memberHierarchy.
+//
+// Nodes live in a flat array while expanding, so adding children does not
+// invalidate their parents. Locations of all nodes are converted by one
+// GetLsLocations call, which resolves each file once, and the nested |Entry|
+// tree is assembled at the end.
+//
+// |Entry| needs |location|, |numChildren| and |children|. An expand callback
+// is invoked as expand(entry, levels, add) and returns false to drop the
+// node. add(Entry, std::optional<Use>) appends a child, which is expanded
+// with |levels - 1|; the Use, if any, becomes its location.
+template <typename Entry> class HierarchyBuilder {
+  struct Node {
+    Entry entry;
+    int parent;
+    int levels;
+    std::optional<Use> use;
+    bool valid = true;
+  };
+  std::vector<Node> nodes_;
+
+public:
+  // Once |max_nodes| nodes exist, the remaining ones are expanded as if
+  // |levels| were 0, so clients can expand them later. 0: unbounded.
+  int max_nodes = 0;
+  // If true, numChildren of a node whose children were expanded is the number
+  // of children which were not dropped.
+  bool count_kept = false;
+
+  // |expand_root| is used for |root| and |expand| for all other nodes.
+  template <typename ExpandRoot, typename Expand>
+  bool Build(DB *db, WorkingFiles *wfiles, Entry *root, int levels,
+             ExpandRoot &&expand_root, Expand &&expand) {
+    nodes_.clear();
+    nodes_.push_back({std::move(*root), -1, levels});
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      int levels1 = nodes_[i].levels;
+      if (max_nodes > 0 && int(nodes_.size()) >= max_nodes)
+        levels1 = 0;
+      // |nodes_| may grow in |add|, so do not hold a reference.
+      Entry entry = std::move(nodes_[i].entry);
+      auto add = [&](Entry child, std::optional<Use> use) {
+        nodes_.push_back({std::move(child), int(i), levels1 - 1, use});
+      };
+      bool valid = i ? expand(entry, levels1, add)
+                     : expand_root(entry, levels1, add);
+      nodes_[i].entry = std::move(entry);
+      nodes_[i].levels = levels1;
+      nodes_[i].valid = valid;
+    }
+
+    std::vector<Use> uses;
+    std::vector<int> idx;
+    for (size_t i = 0; i < nodes_.size(); i++)
+      if (nodes_[i].use) {
+        uses.push_back(*nodes_[i].use);
+        idx.push_back(int(i));
+      }
+    std::vector<std::optional<lsLocation>> locs =
+        GetLsLocations(db, wfiles, uses);
+    for (size_t i = 0; i < locs.size(); i++)
+      if (locs[i])
+        nodes_[idx[i]].entry.location = *locs[i];
+
+    // Children have larger indices than their parent, so walking backwards
+    // moves each node after its own children are complete. They are appended
+    // in reverse order.
+    for (size_t i = nodes_.size(); i--;) {
+      Node &node = nodes_[i];
+      std::reverse(node.entry.children.begin(), node.entry.children.end());
+      if (count_kept && node.levels > 0)
+        node.entry.numChildren = int(node.entry.children.size());
+      if (i && node.valid)
+        nodes_[node.parent].entry.children.push_back(std::move(node.entry));
+    }
+    *root = std::move(nodes_[0].entry);
+    bool valid = nodes_[0].valid;
+    nodes_.clear();
+    return valid;
+  }
+  template <typename Expand>
+  bool Build(DB *db, WorkingFiles *wfiles, Entry *root, int levels,
+             Expand &&expand) {
+    return Build(db, wfiles, root, levels, expand, expand);
+  }
+};
+} // namespace ccls
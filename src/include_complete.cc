@@ -87,6 +87,68 @@ lsCompletionItem BuildCompletionItem(const std::string& path,
   return item;
 }
 
+// Compares ASCII case-insensitively.
+int CompareFolded(std::string_view l, std::string_view r) {
+  for (size_t i = 0; i < l.size() && i < r.size(); i++) {
+    int c = tolower((unsigned char)l[i]) - tolower((unsigned char)r[i]);
+    if (c)
+      return c;
+  }
+  return l.size() < r.size() ? -1 : l.size() > r.size();
+}
+
+// Maps characters to bits such that a case-insensitive subsequence of a string
+// only has bits set in the string's mask.
+uint64_t CharMask(std::string_view s) {
+  uint64_t mask = 0;
+  for (unsigned char c : s) {
+    c = tolower(c);
+    if ('a' <= c && c <= 'z')
+      mask |= uint64_t(1) << (c - 'a');
+    else if ('0' <= c && c <= '9')
+      mask |= uint64_t(1) << (c - '0' + 26);
+    else
+      mask |= uint64_t(1) << (c % 28 + 36);
+  }
+  return mask;
+}
+
+using WalkFn = std::function<void(
+    const std::string&, const std::function<void(const std::string&)>&)>;
+
+// Collects candidates from all include directories, whose files are listed by
+// |walk|.
+std::vector<CompletionCandidate> CollectIncludes(Project* project,
+                                                 GroupMatch* match,
+                                                 const WalkFn& walk) {
+  std::vector<CompletionCandidate> results;
+  auto collect = [&](std::string directory, bool use_angle_brackets) {
+    directory = NormalizePath(directory);
+    EnsureEndsInSlash(directory);
+    if (match && !match->IsMatch(directory))
+      return;
+    bool include_cpp = directory.find("include/c++") != std::string::npos;
+    walk(directory, [&](const std::string& absolute_path) {
+      std::string path = absolute_path.substr(directory.size());
+      if (!include_cpp &&
+          !EndsWithAny(path, g_config->completion.includeSuffixWhitelist))
+        return;
+      if (match && !match->IsMatch(absolute_path))
+        return;
+
+      CompletionCandidate candidate;
+      candidate.absolute_path = absolute_path;
+      candidate.completion_item =
+          BuildCompletionItem(path, use_angle_brackets, false /*is_stl*/);
+      results.push_back(std::move(candidate));
+    });
+  };
+  for (const std::string& dir : project->quote_include_directories)
+    collect(dir, false /*use_angle_brackets*/);
+  for (const std::string& dir : project->angle_include_directories)
+    collect(dir, true /*use_angle_brackets*/);
+  return results;
+}
 }  // namespace
 
 IncludeComplete::IncludeComplete(Project* project)
@@ -96,14 +158,11 @@ void IncludeComplete::Rescan() {
   if (is_scanning)
     return;
 
-  completion_items.clear();
-  absolute_path_to_completion_item.clear();
-  inserted_paths.clear();
-
   if (!match_ && (g_config->completion.includeWhitelist.size() ||
                   g_config->completion.includeBlacklist.size()))
-    match_ = std::make_unique<GroupMatch>(g_config->completion.includeWhitelist,
-                                          g_config->completion.includeBlacklist);
+    match_ = std::make_unique<GroupMatch>(
+        g_config->completion.includeWhitelist,
+        g_config->completion.includeBlacklist);
 
   is_scanning = true;
   std::thread([this]() {
@@ -111,18 +170,66 @@ void IncludeComplete::Rescan() {
     Timer timer("include", "scan include paths");
     TimeRegion region(timer);
 
-    for (const std::string& dir : project_->quote_include_directories)
-      InsertIncludesFromDirectory(dir, false /*use_angle_brackets*/);
-    for (const std::string& dir : project_->angle_include_directories)
-      InsertIncludesFromDirectory(dir, true /*use_angle_brackets*/);
-
-    is_scanning = false;
+    // Items are built aside and swapped in, so completion requests are not
+    // blocked during the scan.
+    auto publish = [&](std::vector<CompletionCandidate>&& results,
+                       bool done) {
+      std::lock_guard<std::mutex> lock(completion_items_mutex);
+      completion_items.clear();
+      absolute_path_to_completion_item.clear();
+      inserted_paths.clear();
+      label_masks.clear();
+      for (CompletionCandidate& result : results)
+        InsertCompletionItem(result.absolute_path,
+                             std::move(result.completion_item));
+      sorted_items.resize(completion_items.size());
+      for (size_t i = 0; i < sorted_items.size(); i++)
+        sorted_items[i] = i;
+      std::sort(sorted_items.begin(), sorted_items.end(), [&](int l, int r) {
+        return CompareFolded(completion_items[l].detail,
+                             completion_items[r].detail) < 0;
+      });
+      for (const std::string& path : added_files) {
+        std::string trimmed_path = path;
+        bool use_angle_brackets =
+            TrimPath(project_, g_config->projectRoot, &trimmed_path);
+        InsertCompletionItem(path, BuildCompletionItem(trimmed_path,
+                                                       use_angle_brackets,
+                                                       false /*is_stl*/));
+      }
+      if (done) {
+        added_files.clear();
+        is_scanning = false;
+      }
+    };
+
+    std::string cache_path = g_config->cacheDirectory +
+                             EscapeFileName(g_config->projectRoot) +
+                             "@include.json";
+    DirListingCache cache, visited;
+    LoadDirListingCache(cache_path, &cache);
+    if (cache.size())
+      publish(CollectIncludes(project_, match_.get(),
+                              [&](const std::string& dir, auto& handler) {
+                                WalkCachedFolder(dir, cache, handler);
+                              }),
+              false);
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<CompletionCandidate> results = CollectIncludes(
+        project_, match_.get(), [&](const std::string& dir, auto& handler) {
+          WalkFolder(dir, threads, [](const std::string&) { return false; },
+                     cache, &visited, handler);
+        });
+    SaveDirListingCache(cache_path, visited);
+    publish(std::move(results), true);
   }).detach();
 }
 
 void IncludeComplete::InsertCompletionItem(const std::string& absolute_path,
                                            lsCompletionItem&& item) {
   if (inserted_paths.insert({item.detail, inserted_paths.size()}).second) {
+    label_masks.push_back(CharMask(item.label));
     completion_items.push_back(item);
     // insert if not found or with shorter include path
     auto it = absolute_path_to_completion_item.find(absolute_path);
@@ -153,42 +260,13 @@ void IncludeComplete::AddFile(const std::string& absolute_path) {
       BuildCompletionItem(trimmed_path, use_angle_brackets, false /*is_stl*/);
 
   std::unique_lock<std::mutex> lock(completion_items_mutex, std::defer_lock);
-  if (is_scanning)
+  if (is_scanning) {
     lock.lock();
+    added_files.push_back(absolute_path);
+  }
   InsertCompletionItem(absolute_path, std::move(item));
 }
 
-void IncludeComplete::InsertIncludesFromDirectory(std::string directory,
-                                                  bool use_angle_brackets) {
-  directory = NormalizePath(directory);
-  EnsureEndsInSlash(directory);
-  if (match_ && !match_->IsMatch(directory))
-    return;
-  bool include_cpp = directory.find("include/c++") != std::string::npos;
-
-  std::vector<CompletionCandidate> results;
-  GetFilesInFolder(
-      directory, true /*recursive*/, false /*add_folder_to_path*/,
-      [&](const std::string &path) {
-        if (!include_cpp &&
-            !EndsWithAny(path, g_config->completion.includeSuffixWhitelist))
-          return;
-        if (match_ && !match_->IsMatch(directory + path))
-          return;
-
-        CompletionCandidate candidate;
-        candidate.absolute_path = directory + path;
-        candidate.completion_item =
-            BuildCompletionItem(path, use_angle_brackets, false /*is_stl*/);
-        results.push_back(candidate);
-      });
-
-  std::lock_guard<std::mutex> lock(completion_items_mutex);
-  for (CompletionCandidate& result : results)
-    InsertCompletionItem(result.absolute_path,
-                         std::move(result.completion_item));
-}
-
 std::optional<lsCompletionItem> IncludeComplete::FindCompletionItemForAbsolutePath(
     const std::string& absolute_path) {
   std::lock_guard<std::mutex> lock(completion_items_mutex);
@@ -198,3 +276,72 @@ std::optional<lsCompletionItem> IncludeComplete::FindCompletionItemForAbsolutePa
     return std::nullopt;
   return completion_items[it->second];
 }
+
+std::vector<lsCompletionItem> IncludeComplete::FindCandidates(
+    const std::string& pattern, const std::string& quote) {
+  std::unique_lock<std::mutex> lock(completion_items_mutex, std::defer_lock);
+  if (is_scanning)
+    lock.lock();
+
+  std::vector<lsCompletionItem> result;
+  auto quote_ok = [&](const lsCompletionItem& item) {
+    return quote.empty() || quote == (item.use_angle_brackets_ ? "<" : "\"");
+  };
+  // Without filterAndSort the client does the filtering, so every item is
+  // returned.
+  if (!g_config->completion.filterAndSort) {
+    for (const lsCompletionItem& item : completion_items)
+      if (quote_ok(item))
+        result.push_back(item);
+    return result;
+  }
+
+  // Completion filtering requires |pattern| to be a subsequence of the label,
+  // so the label must contain all of its characters in either case.
+  uint64_t mask = CharMask(pattern);
+  std::vector<bool> added(completion_items.size());
+  auto add = [&](int i, bool under_dir) {
+    const lsCompletionItem& item = completion_items[i];
+    added[i] = true;
+    if ((label_masks[i] & mask) == mask && quote_ok(item)) {
+      result.push_back(item);
+      if (under_dir)
+        result.back().priority_ = 0;
+    }
+  };
+
+  // If a directory has been typed, the items under it come first and win ties
+  // in FilterAndSortCompletionResponse. They are found by binary search on
+  // the include paths, which are sorted ignoring case. The prefix comparison
+  // follows completion.caseSensitivity like the fuzzy matching does.
+  size_t slash = pattern.rfind('/');
+  if (slash != std::string::npos) {
+    std::string_view dir(pattern.data(), slash + 1);
+    int sensitivity = g_config->completion.caseSensitivity;
+    bool sensitive =
+        sensitivity == 2 ||
+        (sensitivity == 1 &&
+         std::any_of(dir.begin(), dir.end(), [](char c) { return isupper(c); }));
+    auto compare = [&](int i) {
+      std::string_view detail = completion_items[i].detail;
+      return CompareFolded(detail.substr(0, dir.size()), dir);
+    };
+    auto under = [&](int i) {
+      return sensitive ? StartsWith(completion_items[i].detail, dir)
+                       : compare(i) == 0;
+    };
+    auto it = std::lower_bound(
+        sorted_items.begin(), sorted_items.end(), dir,
+        [&](int i, std::string_view) { return compare(i) < 0; });
+    for (; it != sorted_items.end() && compare(*it) == 0; ++it)
+      if (under(*it))
+        add(*it, true);
+    for (size_t i = sorted_items.size(); i < completion_items.size(); i++)
+      if (under(i))
+        add(i, true);
+  }
+  for (size_t i = 0; i < completion_items.size(); i++)
+    if (!added[i])
+      add(i, false);
+  return result;
+}
@@ -12,20 +12,24 @@ struct Project;
 struct IncludeComplete {
   IncludeComplete(Project* project);
 
-  // Starts scanning directories. Clears existing cache.
+  // Starts scanning directories in the background. Items from the listings
+  // saved by the previous scan are available first. The scan then revisits
+  // directories whose mtime changed and replaces the items.
   void Rescan();
 
   // Ensures the one-off file is inside |completion_items|.
   void AddFile(const std::string& absolute_path);
 
-  // Scans the given directory and inserts all includes from this. This is a
-  // blocking function and should be run off the querydb thread.
-  void InsertIncludesFromDirectory(std::string directory,
-                                   bool use_angle_brackets);
-
   std::optional<lsCompletionItem> FindCompletionItemForAbsolutePath(
       const std::string& absolute_path);
 
+  // Returns the items which may match |pattern|, the path typed so far, in
+  // completion filtering, those under the typed directory first. If |quote|
+  // is '"' or '<', only items using that quote are returned. Every item is
+  // returned if completion.filterAndSort is false.
+  std::vector<lsCompletionItem> FindCandidates(const std::string& pattern,
+                                               const std::string& quote);
+
   // Insert item to |completion_items|.
   // Update |absolute_path_to_completion_item| and |inserted_paths|.
   void InsertCompletionItem(const std::string& absolute_path,
@@ -36,6 +40,10 @@ struct IncludeComplete {
   std::atomic<bool> is_scanning;
   std::vector<lsCompletionItem> completion_items;
 
+  // Files passed to AddFile during a scan, which are added again when the
+  // scan replaces |completion_items|.
+  std::vector<std::string> added_files;
+
   // Absolute file path to the completion item in |completion_items|.
   // Keep the one with shortest include path.
   std::unordered_map<std::string, int> absolute_path_to_completion_item;
@@ -43,6 +51,13 @@ struct IncludeComplete {
   // Only one completion item per include path.
   std::unordered_map<std::string, int> inserted_paths;
 
+  // Characters in the label of each item, see FindCandidates.
+  std::vector<uint64_t> label_masks;
+  // Indices of |completion_items| sorted by include path ignoring case, so
+  // that items under a directory form a range. Items inserted after the last scan are not
+  // included.
+  std::vector<int> sorted_items;
+
   // Cached references
   Project* project_;
   std::unique_ptr<GroupMatch> match_;
@@ -705,10 +705,9 @@ public:
             for (const Decl *D1 = GetTypeDecl(T); D1; D1 = GetSpecialized(D1)) {
               IndexParam::DeclInfo* info1;
               Usr usr1 = GetUsr(D1, &info1);
-              auto it = db->usr2type.find(usr1);
-              if (it != db->usr2type.end()) {
+              if (IndexType *type1 = db->usr2type.find(usr1)) {
                 var->def.type = usr1;
-                it->second.instances.push_back(usr);
+                type1->instances.push_back(usr);
                 break;
               }
               // e.g. TemplateTypeParmDecl is not handled by handleDeclOccurence.
@@ -1084,24 +1083,15 @@ IndexFile::IndexFile(llvm::sys::fs::UniqueID UniqueID, const std::string &path,
     : UniqueID(UniqueID), path(path), file_contents(contents) {}
 
 IndexFunc& IndexFile::ToFunc(Usr usr) {
-  auto [it, inserted] = usr2func.try_emplace(usr);
-  if (inserted)
-    it->second.usr = usr;
-  return it->second;
+  return usr2func[usr];
 }
 
 IndexType& IndexFile::ToType(Usr usr) {
-  auto [it, inserted] = usr2type.try_emplace(usr);
-  if (inserted)
-    it->second.usr = usr;
-  return it->second;
+  return usr2type[usr];
 }
 
 IndexVar& IndexFile::ToVar(Usr usr) {
-  auto [it, inserted] = usr2var.try_emplace(usr);
-  if (inserted)
-    it->second.usr = usr;
-  return it->second;
+  return usr2var[usr];
 }
 
 std::string IndexFile::ToString() {
@@ -1125,14 +1115,12 @@ std::vector<std::unique_ptr<IndexFile>> Index(
     VFS* vfs,
     const std::string& opt_wdir,
     const std::string& file,
-    const std::vector<std::string>& args,
+    const CompileArgs& args,
     const std::vector<FileContents>& file_contents) {
   if (!g_config->index.enabled)
     return {};
 
-  std::vector<const char *> Args;
-  for (auto& arg: args)
-    Args.push_back(arg.c_str());
+  std::vector<const char *> Args(args.begin(), args.end());
   auto PCHCO = std::make_shared<PCHContainerOperations>();
   IntrusiveRefCntPtr<DiagnosticsEngine>
     Diags(CompilerInstance::createDiagnostics(new DiagnosticOptions));
@@ -1218,20 +1206,20 @@ std::vector<std::unique_ptr<IndexFile>> Index(
     for (auto &[_, it] : entry->uid2lid_and_path)
       entry->lid2path.emplace_back(it.first, std::move(it.second));
     entry->uid2lid_and_path.clear();
-    for (auto& it : entry->usr2func) {
+    for (IndexFunc& func : entry->usr2func) {
       // e.g. declaration + out-of-line definition
-      Uniquify(it.second.derived);
-      Uniquify(it.second.uses);
+      Uniquify(func.derived);
+      Uniquify(func.uses);
     }
-    for (auto& it : entry->usr2type) {
-      Uniquify(it.second.derived);
-      Uniquify(it.second.uses);
+    for (IndexType& type : entry->usr2type) {
+      Uniquify(type.derived);
+      Uniquify(type.uses);
       // e.g. declaration + out-of-line definition
-      Uniquify(it.second.def.bases);
-      Uniquify(it.second.def.funcs);
+      Uniquify(type.def.bases);
+      Uniquify(type.def.funcs);
     }
-    for (auto& it : entry->usr2var)
-      Uniquify(it.second.uses);
+    for (IndexVar& var : entry->usr2var)
+      Uniquify(var.uses);
 
     if (main_file) {
       // If there are errors, show at least one at the include position.
@@ -12,6 +12,7 @@
 #include "utils.h"
 
 #include <clang/Basic/Specifiers.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/StringMap.h>
 
 #include <stdint.h>
@@ -245,6 +246,83 @@ struct IndexInclude {
   std::string resolved_path;
 };
 
+// Entities of one kind in an IndexFile, keyed by Usr. Entities are appended
+// to blocks of doubling capacity which are never reallocated, so references
+// stay valid while the indexer adds more entities, and iteration walks a few
+// contiguous arrays in insertion order.
+template <typename V> class UsrMap {
+  template <typename Blocks, typename T> class Iterator {
+    Blocks *blocks_;
+    size_t b_, i_ = 0;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = V;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    Iterator(Blocks *blocks, size_t b) : blocks_(blocks), b_(b) {}
+    T &operator*() const { return (*blocks_)[b_][i_]; }
+    T *operator->() const { return &(*blocks_)[b_][i_]; }
+    Iterator &operator++() {
+      if (++i_ == (*blocks_)[b_].size()) {
+        b_++;
+        i_ = 0;
+      }
+      return *this;
+    }
+    bool operator==(const Iterator &o) const {
+      return b_ == o.b_ && i_ == o.i_;
+    }
+    bool operator!=(const Iterator &o) const { return !(*this == o); }
+  };
+
+  static constexpr size_t kMinBlockSize = 16;
+  std::vector<std::vector<V>> blocks_;
+  llvm::DenseMap<Usr, V *> index_;
+  size_t size_ = 0;
+
+public:
+  using iterator = Iterator<std::vector<std::vector<V>>, V>;
+  using const_iterator = Iterator<const std::vector<std::vector<V>>, const V>;
+
+  UsrMap() = default;
+  // |index_| points into |blocks_|.
+  UsrMap(const UsrMap &) = delete;
+  UsrMap(UsrMap &&) = default;
+  UsrMap &operator=(const UsrMap &) = delete;
+  UsrMap &operator=(UsrMap &&) = default;
+
+  iterator begin() { return {&blocks_, 0}; }
+  iterator end() { return {&blocks_, blocks_.size()}; }
+  const_iterator begin() const { return {&blocks_, 0}; }
+  const_iterator end() const { return {&blocks_, blocks_.size()}; }
+  size_t size() const { return size_; }
+
+  // Returns nullptr if |usr| has no entity.
+  V *find(Usr usr) {
+    auto it = index_.find(usr);
+    return it == index_.end() ? nullptr : it->second;
+  }
+  // Returns the entity of |usr|, appending an empty one if it does not exist.
+  V &operator[](Usr usr) {
+    auto [it, inserted] = index_.try_emplace(usr, nullptr);
+    if (inserted) {
+      if (blocks_.empty() ||
+          blocks_.back().size() == blocks_.back().capacity()) {
+        size_t n = std::max(kMinBlockSize, size_);
+        blocks_.emplace_back().reserve(n);
+      }
+      V &v = blocks_.back().emplace_back();
+      v.usr = usr;
+      it->second = &v;
+      size_++;
+    }
+    return *it->second;
+  }
+};
+
 struct IndexFile {
   // For both JSON and MessagePack cache files.
   static const int kMajorVersion;
@@ -256,7 +334,7 @@ struct IndexFile {
 
   llvm::sys::fs::UniqueID UniqueID;
   std::string path;
-  std::vector<std::string> args;
+  ccls::CompileArgs args;
   int64_t last_write_time = 0;
   LanguageId language = LanguageId::Unknown;
 
@@ -276,9 +354,9 @@ struct IndexFile {
 
   std::vector<IndexInclude> includes;
   llvm::StringMap<int64_t> dependencies;
-  std::unordered_map<Usr, IndexFunc> usr2func;
-  std::unordered_map<Usr, IndexType> usr2type;
-  std::unordered_map<Usr, IndexVar> usr2var;
+  UsrMap<IndexFunc> usr2func;
+  UsrMap<IndexType> usr2type;
+  UsrMap<IndexVar> usr2var;
 
   // Diagnostics found when indexing this file. Not serialized.
   std::vector<lsDiagnostic> diagnostics_;
@@ -298,6 +376,6 @@ struct IndexFile {
 namespace ccls::idx {
 std::vector<std::unique_ptr<IndexFile>>
 Index(VFS *vfs, const std::string &opt_wdir, const std::string &file,
-  const std::vector<std::string> &args,
+  const CompileArgs &args,
   const std::vector<FileContents> &file_contents);
 }
@@ -10,8 +10,14 @@ struct CommandArgs {
 MAKE_REFLECT_STRUCT_WRITER_AS_ARRAY(CommandArgs, textDocumentUri, edits);
 
 // codeLens
-struct lsCodeLensUserData {};
-MAKE_REFLECT_EMPTY_STRUCT(lsCodeLensUserData);
+// Identifies the lens to codeLens/resolve.
+struct lsCodeLensUserData {
+  lsDocumentUri uri;
+  // Usr of the symbol. A string because JSON numbers may lose precision.
+  std::string id;
+  int kind = 0;
+};
+MAKE_REFLECT_STRUCT(lsCodeLensUserData, uri, id, kind);
 
 struct lsCodeLensCommandArguments {
   lsDocumentUri uri;
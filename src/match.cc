@@ -4,6 +4,86 @@
 #include "pipeline.hh"
 using namespace ccls;
 
+#include <ctype.h>
+#include <string.h>
+
+namespace {
+// Cached decisions are dropped when there are this many.
+const size_t kMaxCachedDecisions = 1 << 16;
+
+std::string ToLower(std::string s) {
+  for (char& c : s)
+    c = tolower((unsigned char)c);
+  return s;
+}
+
+// Recognizes patterns such as "/build/", "^/usr/include/", "\.cc$" and
+// ".*/CACHE/.*", which are literals with optional anchors.
+bool ParseLiteral(const std::string& re, Matcher::Literal* kind,
+                  std::string* text) {
+  size_t b = 0, e = re.size();
+  bool start = false, end = false;
+  if (b < e && re[b] == '^')
+    start = true, b++;
+  if (b < e && re[e - 1] == '$') {
+    size_t n = 0;
+    while (e - 1 - n > b && re[e - 2 - n] == '\\')
+      n++;
+    if (n % 2 == 0)
+      end = true, e--;
+  }
+  // ".*" at either end does not change the result of regex_search.
+  while (e - b >= 2 && re.compare(b, 2, ".*") == 0)
+    start = false, b += 2;
+  while (e - b >= 2 && re.compare(e - 2, 2, ".*") == 0 &&
+         (e - b == 2 || re[e - 3] != '\\'))
+    end = false, e -= 2;
+
+  text->clear();
+  for (size_t i = b; i < e; i++) {
+    char c = re[i];
+    if (c == '\\') {
+      // \d, \b, \1 and the like are not literals.
+      if (i + 1 >= e || isalnum((unsigned char)re[i + 1]))
+        return false;
+      c = re[++i];
+    } else if (strchr(".[]()*+?{}|^$", c)) {
+      return false;
+    }
+    *text += tolower((unsigned char)c);
+  }
+  *kind = start ? (end ? Matcher::Literal::Exact : Matcher::Literal::Prefix)
+                : (end ? Matcher::Literal::Suffix : Matcher::Literal::Anywhere);
+  return true;
+}
+
+// Back-references are numbered across the whole alternation, so patterns using
+// them cannot be combined.
+bool HasBackReference(const std::string& re) {
+  for (size_t i = 0; i + 1 < re.size(); i++)
+    if (re[i] == '\\') {
+      if ('1' <= re[i + 1] && re[i + 1] <= '9')
+        return true;
+      i++;
+    }
+  return false;
+}
+
+std::optional<std::regex> CombineRegexes(const std::vector<Matcher>& matchers) {
+  std::string combined;
+  for (const Matcher& m : matchers)
+    if (m.literal == Matcher::Literal::None &&
+        !HasBackReference(m.regex_string))
+      combined += (combined.empty() ? "(?:" : "|(?:") + m.regex_string + ")";
+  if (combined.empty())
+    return std::nullopt;
+  return std::regex(combined, std::regex_constants::ECMAScript |
+                                  std::regex_constants::icase |
+                                  std::regex_constants::nosubs |
+                                  std::regex_constants::optimize);
+}
+}  // namespace
+
 // static
 std::optional<Matcher> Matcher::Create(const std::string& search) {
   /*
@@ -19,6 +99,8 @@ std::optional<Matcher> Matcher::Create(const std::string& search) {
   try {
     Matcher m;
     m.regex_string = search;
+    if (ParseLiteral(search, &m.literal, &m.literal_text))
+      return m;
     m.regex = std::regex(
         search, std::regex_constants::ECMAScript | std::regex_constants::icase |
                     std::regex_constants::optimize
@@ -37,13 +119,31 @@ std::optional<Matcher> Matcher::Create(const std::string& search) {
 }
 
 bool Matcher::IsMatch(const std::string& value) const {
-  // std::smatch match;
-  // return std::regex_match(value, match, regex);
-  return std::regex_search(value, regex, std::regex_constants::match_any);
+  return IsMatch(value, literal == Literal::None ? value : ToLower(value));
+}
+
+bool Matcher::IsMatch(const std::string& value,
+                      const std::string& lower) const {
+  const std::string& t = literal_text;
+  switch (literal) {
+  case Literal::None:
+    return std::regex_search(value, regex, std::regex_constants::match_any);
+  case Literal::Anywhere:
+    return lower.find(t) != std::string::npos;
+  case Literal::Prefix:
+    return lower.compare(0, t.size(), t) == 0;
+  case Literal::Suffix:
+    return lower.size() >= t.size() &&
+           lower.compare(lower.size() - t.size(), t.size(), t) == 0;
+  case Literal::Exact:
+    return lower == t;
+  }
+  return false;
 }
 
 GroupMatch::GroupMatch(const std::vector<std::string>& whitelist,
-                       const std::vector<std::string>& blacklist) {
+                       const std::vector<std::string>& blacklist, bool cache)
+    : cache_enabled_(cache) {
   for (const std::string& entry : whitelist) {
     std::optional<Matcher> m = Matcher::Create(entry);
     if (m)
@@ -54,22 +154,67 @@ GroupMatch::GroupMatch(const std::vector<std::string>& whitelist,
     if (m)
       this->blacklist.push_back(*m);
   }
+  try {
+    whitelist_regex_ = CombineRegexes(this->whitelist);
+    blacklist_regex_ = CombineRegexes(this->blacklist);
+  } catch (const std::exception&) {
+    // Fall back to matching patterns one by one.
+    whitelist_regex_.reset();
+    blacklist_regex_.reset();
+  }
+}
+
+bool GroupMatch::AnyMatch(const std::vector<Matcher>& matchers,
+                          const std::optional<std::regex>& combined,
+                          const std::string& value,
+                          const std::string& lower) const {
+  for (const Matcher& m : matchers)
+    if (m.literal != Matcher::Literal::None && m.IsMatch(value, lower))
+      return true;
+  if (combined &&
+      std::regex_search(value, *combined, std::regex_constants::match_any))
+    return true;
+  for (const Matcher& m : matchers)
+    if (m.literal == Matcher::Literal::None &&
+        (!combined || HasBackReference(m.regex_string)) &&
+        m.IsMatch(value, lower))
+      return true;
+  return false;
 }
 
 bool GroupMatch::IsMatch(const std::string& value,
                          std::string* match_failure_reason) const {
-  for (const Matcher& m : whitelist) {
-    if (m.IsMatch(value))
-      return true;
+  if (whitelist.empty() && blacklist.empty())
+    return true;
+  int decision = -2;
+  if (cache_enabled_) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(value);
+    if (it != cache_.end())
+      decision = it->second;
   }
-
-  for (const Matcher& m : blacklist) {
-    if (m.IsMatch(value)) {
-      if (match_failure_reason)
-        *match_failure_reason = "blacklist \"" + m.regex_string + "\"";
-      return false;
+  if (decision == -2) {
+    decision = -1;
+    std::string lower = ToLower(value);
+    if (!AnyMatch(whitelist, whitelist_regex_, value, lower) &&
+        AnyMatch(blacklist, blacklist_regex_, value, lower))
+      for (size_t i = 0; i < blacklist.size(); i++)
+        if (blacklist[i].IsMatch(value, lower)) {
+          decision = i;
+          break;
+        }
+    if (cache_enabled_) {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      if (cache_.size() >= kMaxCachedDecisions)
+        cache_.clear();
+      cache_.emplace(value, decision);
     }
   }
 
-  return true;
+  if (decision < 0)
+    return true;
+  if (match_failure_reason)
+    *match_failure_reason =
+        "blacklist \"" + blacklist[decision].regex_string + "\"";
+  return false;
 }
@@ -2,27 +2,58 @@
 
 #include <optional>
 
+#include <mutex>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct Matcher {
   static std::optional<Matcher> Create(const std::string& search);
 
   bool IsMatch(const std::string& value) const;
+  // |lower| is |value| in lowercase.
+  bool IsMatch(const std::string& value, const std::string& lower) const;
 
   std::string regex_string;
   std::regex regex;
+
+  // Patterns which are a literal string, possibly anchored or surrounded by
+  // ".*", are matched by string comparison instead of |regex|.
+  enum class Literal { None, Anywhere, Prefix, Suffix, Exact };
+  Literal literal = Literal::None;
+  // Lowercased, as patterns are case-insensitive.
+  std::string literal_text;
 };
 
 // Check multiple |Matcher| instances at the same time.
 struct GroupMatch {
+  // If |cache| is true, decisions are remembered per value. Use it for
+  // long-lived matchers which see the same paths repeatedly, not for scans
+  // which check each path once.
   GroupMatch(const std::vector<std::string>& whitelist,
-             const std::vector<std::string>& blacklist);
+             const std::vector<std::string>& blacklist, bool cache = false);
 
   bool IsMatch(const std::string& value,
                std::string* match_failure_reason = nullptr) const;
 
   std::vector<Matcher> whitelist;
   std::vector<Matcher> blacklist;
-};
\ No newline at end of file
+
+ private:
+  // Whether any matcher in |matchers| matches, using |combined| for regexes.
+  bool AnyMatch(const std::vector<Matcher>& matchers,
+                const std::optional<std::regex>& combined,
+                const std::string& value,
+                const std::string& lower) const;
+
+  // The non-literal patterns of |whitelist| and |blacklist| as one
+  // alternation each, so that a path is scanned once per list.
+  std::optional<std::regex> whitelist_regex_, blacklist_regex_;
+
+  // Decisions for recently checked values if |cache_enabled_|: -1 if |value|
+  // matches, otherwise the index of the rejecting blacklist pattern.
+  bool cache_enabled_;
+  mutable std::mutex cache_mutex_;
+  mutable std::unordered_map<std::string, int> cache_;
+};
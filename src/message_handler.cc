@@ -103,7 +103,7 @@ SemanticHighlightSymbolCache::SemanticHighlightSymbolCache()
 
 void SemanticHighlightSymbolCache::Init() {
   match_ = std::make_unique<GroupMatch>(g_config->highlight.whitelist,
-                                        g_config->highlight.blacklist);
+                                        g_config->highlight.blacklist, true);
 }
 
 std::shared_ptr<SemanticHighlightSymbolCache::Entry>
@@ -294,6 +294,26 @@ void EmitSemanticHighlighting(DB *db,
     }
   }
 
+  // Index updates of included files and the refresh after the project is
+  // loaded often leave the symbols of this file unchanged. If the buffer has
+  // not changed either, the result would be identical, so skip computing and
+  // sending it. |grouped_symbols| is unordered, so combine symbol hashes with +.
+  size_t hash = 0;
+  for (auto &entry : grouped_symbols) {
+    auto &symbol = entry.second;
+    size_t h = 0;
+    hash_combine(h, symbol.stableId, symbol.parentKind, symbol.kind,
+                 symbol.storage);
+    for (auto &range : symbol.lsRanges)
+      hash_combine(h, range.start.line, range.start.character, range.end.line,
+                   range.end.character);
+    hash += h;
+  }
+  hash_combine(hash, wfile->buffer_generation, g_config->highlight.lsRanges);
+  if (wfile->semantic_highlight_hash == hash)
+    return;
+  wfile->semantic_highlight_hash = hash;
+
   // Make ranges non-overlapping using a scan line algorithm.
   std::vector<ScanLineEvent> events;
   int id = 0;
@@ -379,5 +399,6 @@ void EmitSemanticHighlighting(DB *db,
   for (auto &entry : grouped_symbols)
     if (entry.second.ranges.size() || entry.second.lsRanges.size())
       out.params.symbols.push_back(std::move(entry.second));
+
   pipeline::WriteStdout(kMethodType_CclsPublishSemanticHighlighting, out);
 }
@@ -1,9 +1,11 @@
+#include "hierarchy.hh"
 #include "message_handler.h"
 #include "pipeline.hh"
 using namespace ccls;
 #include "query_utils.h"
 using namespace ccls;
 
+#include <unordered_map>
 #include <unordered_set>
 
 namespace {
@@ -84,49 +86,30 @@ MAKE_REFLECT_STRUCT_MANDATORY_OPTIONAL(Out_CclsCallHierarchy,
                                        id,
                                        result);
 
-bool Expand(MessageHandler* m,
-            Out_CclsCallHierarchy::Entry* entry,
-            bool callee,
-            CallType call_type,
-            bool qualified,
-            int levels) {
-  const QueryFunc& func = m->db->Func(entry->usr);
-  const QueryFunc::Def* def = func.AnyDef();
-  entry->numChildren = 0;
-  if (!def)
-    return false;
-  auto handle = [&](Use use, CallType call_type1) {
-    entry->numChildren++;
-    if (levels > 0) {
-      Out_CclsCallHierarchy::Entry entry1;
-      entry1.id = std::to_string(use.usr);
-      entry1.usr = use.usr;
-      if (auto loc = GetLsLocation(m->db, m->working_files, use))
-        entry1.location = *loc;
-      entry1.callType = call_type1;
-      if (Expand(m, &entry1, callee, call_type, qualified, levels - 1))
-        entry->children.push_back(std::move(entry1));
-    }
-  };
+using Calls = std::vector<std::pair<Use, CallType>>;
+
+// Callers (or callees) of |func| and, depending on |call_type|, of its base
+// and derived functions.
+Calls GetCalls(DB* db, const QueryFunc& func, bool callee, CallType call_type) {
+  Calls ret;
   auto handle_uses = [&](const QueryFunc& func, CallType call_type) {
     if (callee) {
       if (const auto* def = func.AnyDef())
         for (SymbolRef ref : def->callees)
           if (ref.kind == SymbolKind::Func)
-            handle(Use{{ref.range, ref.usr, ref.kind, ref.role},
-                       def->file_id},
-                   call_type);
+            ret.emplace_back(Use{{ref.range, ref.usr, ref.kind, ref.role},
+                                 def->file_id},
+                             call_type);
     } else {
       for (Use use : func.uses)
         if (use.kind == SymbolKind::Func)
-          handle(use, call_type);
+          ret.emplace_back(use, call_type);
     }
   };
 
   std::unordered_set<Usr> seen;
   seen.insert(func.usr);
   std::vector<const QueryFunc*> stack;
-  entry->name = def->Name(qualified);
   handle_uses(func, CallType::Direct);
 
   // Callers/callees of base functions.
@@ -136,7 +119,7 @@ bool Expand(MessageHandler* m,
       const QueryFunc& func1 = *stack.back();
       stack.pop_back();
       if (auto* def1 = func1.AnyDef()) {
-        EachDefinedFunc(m->db, def1->bases, [&](QueryFunc& func2) {
+        EachDefinedFunc(db, def1->bases, [&](QueryFunc& func2) {
           if (!seen.count(func2.usr)) {
             seen.insert(func2.usr);
             stack.push_back(&func2);
@@ -153,7 +136,7 @@ bool Expand(MessageHandler* m,
     while (stack.size()) {
       const QueryFunc& func1 = *stack.back();
       stack.pop_back();
-      EachDefinedFunc(m->db, func1.derived, [&](QueryFunc& func2) {
+      EachDefinedFunc(db, func1.derived, [&](QueryFunc& func2) {
         if (!seen.count(func2.usr)) {
           seen.insert(func2.usr);
           stack.push_back(&func2);
@@ -162,7 +145,43 @@ bool Expand(MessageHandler* m,
       });
     }
   }
-  return true;
+  return ret;
+}
+
+bool Expand(MessageHandler* m,
+            Out_CclsCallHierarchy::Entry* entry,
+            bool callee,
+            CallType call_type,
+            bool qualified,
+            int levels) {
+  // A function reached through many paths, e.g. a utility called from
+  // everywhere, has its calls computed once per request.
+  std::unordered_map<Usr, Calls> usr2calls;
+  HierarchyBuilder<Out_CclsCallHierarchy::Entry> builder;
+  builder.max_nodes = g_config->xref.maxNum;
+  return builder.Build(
+      m->db, m->working_files, entry, levels,
+      [&](Out_CclsCallHierarchy::Entry& entry, int levels, auto add) {
+        const QueryFunc& func = m->db->Func(entry.usr);
+        const QueryFunc::Def* def = func.AnyDef();
+        entry.numChildren = 0;
+        if (!def)
+          return false;
+        entry.name = def->Name(qualified);
+        auto [it, inserted] = usr2calls.try_emplace(entry.usr);
+        if (inserted)
+          it->second = GetCalls(m->db, func, callee, call_type);
+        entry.numChildren = int(it->second.size());
+        if (levels > 0)
+          for (auto& [use, call_type1] : it->second) {
+            Out_CclsCallHierarchy::Entry entry1;
+            entry1.id = std::to_string(use.usr);
+            entry1.usr = use.usr;
+            entry1.callType = call_type1;
+            add(std::move(entry1), use);
+          }
+        return true;
+      });
 }
 
 struct Handler_CclsCallHierarchy
@@ -8,8 +8,16 @@ MethodType kMethodType = "$ccls/callers";
 
 struct In_CclsCallers : public RequestInMessage {
   MethodType GetMethodType() const override { return kMethodType; }
-  lsTextDocumentPositionParams params;
+  struct Params {
+    lsTextDocumentIdentifier textDocument;
+    lsPosition position;
+    // If greater than 1, also return the callers of callers, up to |levels|
+    // calls away from the function.
+    int levels = 1;
+  };
+  Params params;
 };
+MAKE_REFLECT_STRUCT(In_CclsCallers::Params, textDocument, position, levels);
 MAKE_REFLECT_STRUCT(In_CclsCallers, id, params);
 REGISTER_IN_MESSAGE(In_CclsCallers);
 
@@ -36,6 +44,12 @@ struct Handler_CclsCallers : BaseMessageHandler<In_CclsCallers> {
           uses.push_back(func_ref);
         for (Use func_ref : GetUsesForAllDerived(db, func))
           uses.push_back(func_ref);
+        if (request->params.levels > 1)
+          for (Usr usr : GetTransitiveCalls(db, sym.usr, false,
+                                            request->params.levels - 1,
+                                            g_config->xref.maxNum))
+            for (Use use : db->Func(usr).uses)
+              uses.push_back(use);
         out.result = GetLsLocationExs(db, working_files, uses);
         break;
       }
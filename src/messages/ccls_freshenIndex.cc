@@ -7,7 +7,6 @@
 using namespace ccls;
 
 #include <queue>
-#include <unordered_set>
 
 namespace {
 MethodType kMethodType = "$ccls/freshenIndex";
@@ -34,27 +33,17 @@ struct Handler_CclsFreshenIndex : BaseMessageHandler<In_CclsFreshenIndex> {
     GroupMatch matcher(request->params.whitelist, request->params.blacklist);
 
     std::queue<const QueryFile*> q;
-    // |need_index| stores every filename ever enqueued.
-    std::unordered_set<std::string> need_index;
-    // Reverse dependency graph.
-    std::unordered_map<std::string, std::vector<std::string>> graph;
-    // filename -> QueryFile mapping for files haven't enqueued.
-    std::unordered_map<std::string, const QueryFile*> path_to_file;
-
+    // |enqueued[i]| is true if db->files[i] has ever been enqueued.
+    std::vector<bool> enqueued(db->files.size());
     for (const auto& file : db->files)
-      if (file.def) {
-        if (matcher.IsMatch(file.def->path))
-          q.push(&file);
-        else
-          path_to_file[file.def->path] = &file;
-        for (const std::string& dependency : file.def->dependencies)
-          graph[dependency].push_back(file.def->path);
+      if (file.def && matcher.IsMatch(file.def->path)) {
+        q.push(&file);
+        enqueued[file.id] = true;
       }
 
     while (!q.empty()) {
       const QueryFile* file = q.front();
       q.pop();
-      need_index.insert(file->def->path);
 
       std::optional<int64_t> write_time = LastWriteTime(file->def->path);
       if (!write_time)
@@ -67,13 +56,11 @@ struct Handler_CclsFreshenIndex : BaseMessageHandler<In_CclsFreshenIndex> {
       }
 
       if (request->params.dependencies)
-        for (const std::string& path : graph[file->def->path]) {
-          auto it = path_to_file.find(path);
-          if (it != path_to_file.end()) {
-            q.push(it->second);
-            path_to_file.erase(it);
+        for (int id : file->dependents)
+          if (!enqueued[id] && db->files[id].def) {
+            q.push(&db->files[id]);
+            enqueued[id] = true;
           }
-        }
     }
 
     // Send index requests for every file.
@@ -95,7 +95,12 @@ bool ExpandHelper(MessageHandler* m,
   std::unordered_set<Usr> seen;
   if (derived) {
     if (levels > 0) {
-      for (auto usr : entity.derived) {
+      for (DenseId id : entity.derived) {
+        Usr usr;
+        if constexpr (std::is_same_v<Q, QueryFunc>)
+          usr = m->db->Func(id).usr;
+        else
+          usr = m->db->Type(id).usr;
         if (!seen.insert(usr).second)
           continue;
         Out_CclsInheritanceHierarchy::Entry entry1;
@@ -1,3 +1,4 @@
+#include "hierarchy.hh"
 #include "message_handler.h"
 #include "pipeline.hh"
 #include "query_utils.h"
@@ -6,6 +7,7 @@ using namespace ccls;
 #include <clang/AST/Type.h>
 using namespace clang;
 
+#include <unordered_map>
 #include <unordered_set>
 
 namespace {
@@ -68,125 +70,136 @@ MAKE_REFLECT_STRUCT_MANDATORY_OPTIONAL(Out_CclsMemberHierarchy,
                                        id,
                                        result);
 
-bool Expand(MessageHandler* m,
-            Out_CclsMemberHierarchy::Entry* entry,
-            bool qualified,
-            int levels);
+// Expands nodes of the member hierarchy for HierarchyBuilder. The bases of a
+// type reached through several fields are collected once per request.
+struct MemberExpander {
+  MessageHandler* m;
+  bool qualified;
+  std::unordered_map<Usr, std::vector<const QueryType::Def*>> usr2defs;
 
-// Add a field to |entry| which is a Func/Type.
-void DoField(MessageHandler* m,
-             Out_CclsMemberHierarchy::Entry* entry,
-             const QueryVar& var,
-             int64_t offset,
-             bool qualified,
-             int levels) {
-  const QueryVar::Def* def1 = var.AnyDef();
-  if (!def1)
-    return;
-  Out_CclsMemberHierarchy::Entry entry1;
-  // With multiple inheritance, the offset is incorrect.
-  if (offset >= 0) {
-    if (offset / 8 < 10)
+  // Add a field which is a Func/Type.
+  template <typename Add>
+  void DoField(const QueryVar& var, int64_t offset, Add& add) {
+    const QueryVar::Def* def1 = var.AnyDef();
+    if (!def1)
+      return;
+    Out_CclsMemberHierarchy::Entry entry1;
+    // With multiple inheritance, the offset is incorrect.
+    if (offset >= 0) {
+      if (offset / 8 < 10)
+        entry1.fieldName += ' ';
+      entry1.fieldName += std::to_string(offset / 8);
+      if (offset % 8) {
+        entry1.fieldName += '.';
+        entry1.fieldName += std::to_string(offset % 8);
+      }
       entry1.fieldName += ' ';
-    entry1.fieldName += std::to_string(offset / 8);
-    if (offset % 8) {
-      entry1.fieldName += '.';
-      entry1.fieldName += std::to_string(offset % 8);
     }
-    entry1.fieldName += ' ';
-  }
-  if (qualified)
-    entry1.fieldName += def1->detailed_name;
-  else {
-    entry1.fieldName +=
-        std::string_view(def1->detailed_name).substr(0, def1->qual_name_offset);
-    entry1.fieldName += def1->Name(false);
-  }
-  if (def1->spell) {
-    if (std::optional<lsLocation> loc =
-            GetLsLocation(m->db, m->working_files, *def1->spell))
-      entry1.location = *loc;
-  }
-  if (def1->type) {
+    if (qualified)
+      entry1.fieldName += def1->detailed_name;
+    else {
+      entry1.fieldName += std::string_view(def1->detailed_name)
+                              .substr(0, def1->qual_name_offset);
+      entry1.fieldName += def1->Name(false);
+    }
     entry1.id = std::to_string(def1->type);
     entry1.usr = def1->type;
-    if (Expand(m, &entry1, qualified, levels))
-      entry->children.push_back(std::move(entry1));
-  } else {
-    entry1.id = "0";
-    entry1.usr = 0;
-    entry->children.push_back(std::move(entry1));
+    std::optional<Use> use;
+    if (def1->spell)
+      use = *def1->spell;
+    add(std::move(entry1), use);
+  }
+
+  // Expand a type node by adding members to it.
+  template <typename Add>
+  bool operator()(Out_CclsMemberHierarchy::Entry& entry, int levels,
+                  Add& add) {
+    // Field of a type we know nothing about.
+    if (entry.usr == 0)
+      return true;
+    if (entry.usr <= BuiltinType::LastKind) {
+      entry.name = ClangBuiltinTypeName(int(entry.usr));
+      return true;
+    }
+    const QueryType& type = m->db->Type(entry.usr);
+    const QueryType::Def* def = type.AnyDef();
+    // builtin types have no declaration and empty |qualified|.
+    if (!def)
+      return false;
+    entry.name = def->Name(qualified);
+    if (levels <= 0) {
+      entry.numChildren = def->alias_of ? 1 : int(def->vars.size());
+      return true;
+    }
+
+    auto [it, inserted] = usr2defs.try_emplace(type.usr);
+    if (inserted) {
+      std::unordered_set<Usr> seen;
+      std::vector<const QueryType*> stack;
+      seen.insert(type.usr);
+      stack.push_back(&type);
+      while (stack.size()) {
+        const auto* def = stack.back()->AnyDef();
+        stack.pop_back();
+        if (def) {
+          it->second.push_back(def);
+          EachDefinedType(m->db, def->bases, [&](QueryType& type1) {
+            if (!seen.count(type1.usr)) {
+              seen.insert(type1.usr);
+              stack.push_back(&type1);
+            }
+          });
+        }
+      }
+    }
+    for (const QueryType::Def* def : it->second) {
+      if (def->alias_of) {
+        const QueryType::Def* def1 = m->db->Type(def->alias_of).AnyDef();
+        Out_CclsMemberHierarchy::Entry entry1;
+        entry1.id = std::to_string(def->alias_of);
+        entry1.usr = def->alias_of;
+        std::optional<Use> use;
+        if (def1 && def1->spell) {
+          // The declaration of target type.
+          use = *def1->spell;
+        } else if (def->spell) {
+          // Builtin types have no declaration but the typedef declaration
+          // itself is useful.
+          use = *def->spell;
+        }
+        // The name which expanding the alias target would set.
+        if (def->alias_of <= BuiltinType::LastKind)
+          entry1.fieldName = ClangBuiltinTypeName(int(def->alias_of));
+        else if (def1)
+          entry1.fieldName = qualified ? std::string(def1->detailed_name)
+                                       : std::string(def1->Name(false));
+        add(std::move(entry1), use);
+      } else {
+        for (auto [usr1, offset] : def->vars) {
+          QueryVar& var = m->db->Var(usr1);
+          if (!var.def.empty())
+            DoField(var, offset, add);
+        }
+      }
+    }
+    return true;
   }
+};
+
+HierarchyBuilder<Out_CclsMemberHierarchy::Entry> MakeBuilder() {
+  HierarchyBuilder<Out_CclsMemberHierarchy::Entry> builder;
+  builder.max_nodes = g_config->xref.maxNum;
+  builder.count_kept = true;
+  return builder;
 }
 
-// Expand a type node by adding members recursively to it.
 bool Expand(MessageHandler* m,
             Out_CclsMemberHierarchy::Entry* entry,
             bool qualified,
             int levels) {
-  if (0 < entry->usr && entry->usr <= BuiltinType::LastKind) {
-    entry->name = ClangBuiltinTypeName(int(entry->usr));
-    return true;
-  }
-  const QueryType& type = m->db->Type(entry->usr);
-  const QueryType::Def* def = type.AnyDef();
-  // builtin types have no declaration and empty |qualified|.
-  if (!def)
-    return false;
-  entry->name = def->Name(qualified);
-  std::unordered_set<Usr> seen;
-  if (levels > 0) {
-    std::vector<const QueryType*> stack;
-    seen.insert(type.usr);
-    stack.push_back(&type);
-    while (stack.size()) {
-      const auto* def = stack.back()->AnyDef();
-      stack.pop_back();
-      if (def) {
-        EachDefinedType(m->db, def->bases, [&](QueryType& type1) {
-          if (!seen.count(type1.usr)) {
-            seen.insert(type1.usr);
-            stack.push_back(&type1);
-          }
-        });
-        if (def->alias_of) {
-          const QueryType::Def* def1 = m->db->Type(def->alias_of).AnyDef();
-          Out_CclsMemberHierarchy::Entry entry1;
-          entry1.id = std::to_string(def->alias_of);
-          entry1.usr = def->alias_of;
-          if (def1 && def1->spell) {
-            // The declaration of target type.
-            if (std::optional<lsLocation> loc =
-                    GetLsLocation(m->db, m->working_files, *def1->spell))
-              entry1.location = *loc;
-          } else if (def->spell) {
-            // Builtin types have no declaration but the typedef declaration
-            // itself is useful.
-            if (std::optional<lsLocation> loc =
-                    GetLsLocation(m->db, m->working_files, *def->spell))
-              entry1.location = *loc;
-          }
-          if (def1 && qualified)
-            entry1.fieldName = def1->detailed_name;
-          if (Expand(m, &entry1, qualified, levels - 1)) {
-            // For builtin types |name| is set.
-            if (entry1.fieldName.empty())
-              entry1.fieldName = std::string(entry1.name);
-            entry->children.push_back(std::move(entry1));
-          }
-        } else {
-          for (auto it : def->vars) {
-            QueryVar& var = m->db->Var(it.first);
-            if (!var.def.empty())
-              DoField(m, entry, var, it.second, qualified, levels - 1);
-          }
-        }
-      }
-    }
-    entry->numChildren = int(entry->children.size());
-  } else
-    entry->numChildren = def->alias_of ? 1 : int(def->vars.size());
-  return true;
+  MemberExpander expander{m, qualified};
+  return MakeBuilder().Build(m->db, m->working_files, entry, levels,
+                             expander);
 }
 
 struct Handler_CclsMemberHierarchy
@@ -213,9 +226,15 @@ struct Handler_CclsMemberHierarchy
           GetLsLocation(db, working_files, *def->spell))
           entry.location = *loc;
       }
-      EachDefinedVar(db, def->vars, [&](QueryVar& var) {
-          DoField(this, &entry, var, -1, qualified, levels - 1);
-        });
+      MemberExpander expander{this, qualified};
+      MakeBuilder().Build(db, working_files, &entry, levels,
+                          [&](Out_CclsMemberHierarchy::Entry&, int, auto& add) {
+                            EachDefinedVar(db, def->vars, [&](QueryVar& var) {
+                              expander.DoField(var, -1, add);
+                            });
+                            return true;
+                          },
+                          expander);
       return entry;
     }
     case SymbolKind::Type: {
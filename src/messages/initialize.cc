@@ -1,3 +1,4 @@
+#include "file_watcher.hh"
 #include "filesystem.hh"
 #include "include_complete.h"
 #include "log.hh"
@@ -476,6 +477,8 @@ struct Handler_Initialize : BaseMessageHandler<In_InitializeRequest> {
 
     Out_InitializeResponse out;
     out.id = request->id;
+    out.result.capabilities.codeLensProvider.resolveProvider =
+        g_config->codeLens.resolve;
 
     pipeline::WriteStdout(kMethodType, out);
 
@@ -494,6 +497,8 @@ struct Handler_Initialize : BaseMessageHandler<In_InitializeRequest> {
 
     // Open up / load the project.
     project->Load(project_path);
+    if (g_config->index.watch)
+      watcher::Start(project, working_files);
 
     // Start indexer threads. Start this after loading the project, as that
     // may take a long time. Indexer threads will emit status/progress
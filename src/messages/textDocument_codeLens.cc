@@ -6,12 +6,16 @@
 using namespace ccls;
 
 namespace {
-MethodType kMethodType = "textDocument/codeLens";
+MethodType kMethodType = "textDocument/codeLens",
+           kResolveMethodType = "codeLens/resolve";
 
 struct lsDocumentCodeLensParams {
   lsTextDocumentIdentifier textDocument;
+  // ccls extension: if specified, only lenses on these lines, e.g. the visible
+  // part of the document, are returned.
+  std::optional<lsRange> range;
 };
-MAKE_REFLECT_STRUCT(lsDocumentCodeLensParams, textDocument);
+MAKE_REFLECT_STRUCT(lsDocumentCodeLensParams, textDocument, range);
 
 using TCodeLens = lsCodeLens<lsCodeLensUserData, lsCodeLensCommandArguments>;
 struct In_TextDocumentCodeLens : public RequestInMessage {
@@ -29,6 +33,139 @@ struct Out_TextDocumentCodeLens
 };
 MAKE_REFLECT_STRUCT(Out_TextDocumentCodeLens, jsonrpc, id, result);
 
+struct In_CodeLensResolve : public RequestInMessage {
+  MethodType GetMethodType() const override { return kResolveMethodType; }
+  TCodeLens params;
+};
+MAKE_REFLECT_STRUCT(In_CodeLensResolve, id, params);
+REGISTER_IN_MESSAGE(In_CodeLensResolve);
+
+struct Out_CodeLensResolve : public lsOutMessage<Out_CodeLensResolve> {
+  lsRequestId id;
+  TCodeLens result;
+};
+MAKE_REFLECT_STRUCT(Out_CodeLensResolve, jsonrpc, id, result);
+
+// Stored in lsCodeLensUserData::kind.
+enum class LensKind : uint8_t {
+  TypeRefs,
+  DerivedTypes,
+  Vars,
+  Calls,
+  DirectCalls,
+  BaseCalls,
+  DerivedCalls,
+  DerivedFuncs,
+  BaseFuncs,
+  VarRefs,
+};
+struct LensInfo {
+  SymbolKind kind;
+  const char* singular;
+  const char* plural;
+};
+const LensInfo kLensInfo[] = {
+    {SymbolKind::Type, "ref", "refs"},
+    {SymbolKind::Type, "derived", "derived"},
+    {SymbolKind::Type, "var", "vars"},
+    {SymbolKind::Func, "call", "calls"},
+    {SymbolKind::Func, "direct call", "direct calls"},
+    {SymbolKind::Func, "base call", "base calls"},
+    {SymbolKind::Func, "derived call", "derived calls"},
+    {SymbolKind::Func, "derived", "derived"},
+    {SymbolKind::Func, "base", "base"},
+    {SymbolKind::Var, "ref", "refs"},
+};
+
+// The uses listed by a lens. |usr| must exist.
+std::vector<Use> GetLensUses(DB* db, LensKind kind, Usr usr) {
+  switch (kind) {
+  case LensKind::TypeRefs:
+    return db->Type(usr).uses;
+  case LensKind::DerivedTypes:
+    return GetTypeDeclarations(db, db->Type(usr).derived);
+  case LensKind::Vars:
+    return GetVarDeclarations(db, db->Type(usr).instances, true);
+  case LensKind::Calls:
+  case LensKind::DirectCalls:
+    return db->Func(usr).uses;
+  case LensKind::BaseCalls:
+    return GetUsesForAllBases(db, db->Func(usr));
+  case LensKind::DerivedCalls:
+    return GetUsesForAllDerived(db, db->Func(usr));
+  case LensKind::DerivedFuncs:
+    return GetFuncDeclarations(db, db->Func(usr).derived);
+  case LensKind::BaseFuncs:
+    if (const auto* def = db->Func(usr).AnyDef())
+      return GetFuncDeclarations(db, def->bases);
+    break;
+  case LensKind::VarRefs:
+    return db->Var(usr).uses;
+  }
+  return {};
+}
+
+// The number of uses of a lens, without converting their locations or
+// building the list of uses.
+size_t CountLensUses(DB* db, LensKind kind, Usr usr) {
+  switch (kind) {
+  case LensKind::TypeRefs:
+    return db->Type(usr).uses.size();
+  case LensKind::DerivedTypes:
+    return CountTypeDeclarations(db, db->Type(usr).derived);
+  case LensKind::Vars:
+    return CountVarDeclarations(db, db->Type(usr).instances, true);
+  case LensKind::Calls:
+  case LensKind::DirectCalls:
+    return db->Func(usr).uses.size();
+  case LensKind::BaseCalls:
+    return CountUsesForAllBases(db, db->Func(usr));
+  case LensKind::DerivedCalls:
+    return CountUsesForAllDerived(db, db->Func(usr));
+  case LensKind::DerivedFuncs:
+    return CountFuncDeclarations(db, db->Func(usr).derived);
+  case LensKind::BaseFuncs:
+    if (const auto* def = db->Func(usr).AnyDef())
+      return CountFuncDeclarations(db, def->bases);
+    break;
+  case LensKind::VarRefs:
+    return db->Var(usr).uses.size();
+  }
+  return 0;
+}
+
+// Sets the command of |lens|, which lists the locations of its uses.
+void ResolveCodeLens(DB* db, WorkingFiles* working_files, TCodeLens* lens) {
+  const lsCodeLensUserData& data = lens->data;
+  std::vector<lsLocation> locations;
+  Usr usr = 0;
+  try {
+    usr = std::stoull(data.id);
+  } catch (...) {
+  }
+  auto kind = LensKind(data.kind);
+  size_t n = sizeof(kLensInfo) / sizeof(kLensInfo[0]);
+  if (data.kind < 0 || size_t(data.kind) >= n)
+    kind = LensKind::TypeRefs;
+  const LensInfo& info = kLensInfo[int(kind)];
+  bool found = info.kind == SymbolKind::Func   ? db->HasFunc(usr)
+               : info.kind == SymbolKind::Type ? db->HasType(usr)
+                                               : db->HasVar(usr);
+  if (size_t(data.kind) < n && found)
+    for (auto& loc :
+         GetLsLocations(db, working_files, GetLensUses(db, kind, usr)))
+      if (loc)
+        locations.push_back(std::move(*loc));
+
+  lens->command = lsCommand<lsCodeLensCommandArguments>();
+  lens->command->title = std::to_string(locations.size()) + " ";
+  lens->command->title += locations.size() == 1 ? info.singular : info.plural;
+  lens->command->command = "ccls.showReferences";
+  lens->command->arguments.uri = data.uri;
+  lens->command->arguments.position = lens->range.start;
+  lens->command->arguments.locations = std::move(locations);
+}
+
 struct CommonCodeLensParams {
   std::vector<TCodeLens>* result;
   DB* db;
@@ -41,11 +178,10 @@ Use OffsetStartColumn(Use use, int16_t offset) {
   return use;
 }
 
-void AddCodeLens(const char* singular,
-                 const char* plural,
+void AddCodeLens(LensKind kind,
                  CommonCodeLensParams* common,
                  Use use,
-                 const std::vector<Use>& uses,
+                 Usr usr,
                  bool force_display) {
   TCodeLens code_lens;
   std::optional<lsRange> range = GetLsRange(common->working_file, use.range);
@@ -54,30 +190,19 @@ void AddCodeLens(const char* singular,
   if (use.file_id < 0)
     return;
   code_lens.range = *range;
-  code_lens.command = lsCommand<lsCodeLensCommandArguments>();
-  code_lens.command->command = "ccls.showReferences";
-  code_lens.command->arguments.uri = GetLsDocumentUri(common->db, use.file_id);
-  code_lens.command->arguments.position = code_lens.range.start;
-
-  // Add unique uses.
-  std::vector<lsLocation> unique_uses;
-  for (Use use1 : uses) {
-    if (auto ls_loc = GetLsLocation(common->db, common->working_files, use1))
-      unique_uses.push_back(*ls_loc);
+  code_lens.data.uri = GetLsDocumentUri(common->db, use.file_id);
+  code_lens.data.id = std::to_string(usr);
+  code_lens.data.kind = int(kind);
+
+  if (g_config->codeLens.resolve) {
+    // The client resolves visible lenses with codeLens/resolve.
+    if (force_display || CountLensUses(common->db, kind, usr) > 0)
+      common->result->push_back(std::move(code_lens));
+    return;
   }
-  code_lens.command->arguments.locations.assign(unique_uses.begin(),
-                                                unique_uses.end());
-
-  // User visible label
-  size_t num_usages = unique_uses.size();
-  code_lens.command->title = std::to_string(num_usages) + " ";
-  if (num_usages == 1)
-    code_lens.command->title += singular;
-  else
-    code_lens.command->title += plural;
-
-  if (force_display || unique_uses.size() > 0)
-    common->result->push_back(code_lens);
+  ResolveCodeLens(common->db, common->working_files, &code_lens);
+  if (force_display || code_lens.command->arguments.locations.size())
+    common->result->push_back(std::move(code_lens));
 }
 
 struct Handler_TextDocumentCodeLens
@@ -103,8 +228,16 @@ struct Handler_TextDocumentCodeLens
     common.db = db;
     common.working_files = working_files;
     common.working_file = working_files->GetFileByFilename(file->def->path);
+      const std::optional<lsRange>& visible = request->params.range;
 
     for (SymbolRef sym : file->def->outline) {
+      if (visible) {
+        std::optional<lsRange> range =
+            GetLsRange(common.working_file, sym.range);
+        if (!range || range->start.line < visible->start.line ||
+            range->start.line > visible->end.line)
+          continue;
+      }
       // NOTE: We OffsetColumn so that the code lens always show up in a
       // predictable order. Otherwise, the client may randomize it.
       Use use{{sym.range, sym.usr, sym.kind, sym.role}, file->id};
@@ -115,14 +248,13 @@ struct Handler_TextDocumentCodeLens
           const QueryType::Def* def = type.AnyDef();
           if (!def || def->kind == lsSymbolKind::Namespace)
             continue;
-          AddCodeLens("ref", "refs", &common, OffsetStartColumn(use, 0),
-                      type.uses, true /*force_display*/);
-          AddCodeLens("derived", "derived", &common, OffsetStartColumn(use, 1),
-                      GetTypeDeclarations(db, type.derived),
-                      false /*force_display*/);
-          AddCodeLens("var", "vars", &common, OffsetStartColumn(use, 2),
-                      GetVarDeclarations(db, type.instances, true),
+          AddCodeLens(LensKind::TypeRefs, &common, OffsetStartColumn(use, 0),
+                      sym.usr, true /*force_display*/);
+          AddCodeLens(LensKind::DerivedTypes, &common,
+                      OffsetStartColumn(use, 1), sym.usr,
                       false /*force_display*/);
+          AddCodeLens(LensKind::Vars, &common, OffsetStartColumn(use, 2),
+                      sym.usr, false /*force_display*/);
           break;
         }
         case SymbolKind::Func: {
@@ -144,31 +276,32 @@ struct Handler_TextDocumentCodeLens
             return *def;
           };
 
-          std::vector<Use> base_callers = GetUsesForAllBases(db, func);
-          std::vector<Use> derived_callers = GetUsesForAllDerived(db, func);
-          if (base_callers.empty() && derived_callers.empty()) {
+          bool base_callers =
+              CountLensUses(db, LensKind::BaseCalls, sym.usr) > 0;
+          bool derived_callers =
+              CountLensUses(db, LensKind::DerivedCalls, sym.usr) > 0;
+          if (!base_callers && !derived_callers) {
             Use loc = try_ensure_spelling(use);
-            AddCodeLens("call", "calls", &common,
-                        OffsetStartColumn(loc, offset++), func.uses,
+            AddCodeLens(LensKind::Calls, &common,
+                        OffsetStartColumn(loc, offset++), sym.usr,
                         true /*force_display*/);
           } else {
             Use loc = try_ensure_spelling(use);
-            AddCodeLens("direct call", "direct calls", &common,
-                        OffsetStartColumn(loc, offset++), func.uses,
+            AddCodeLens(LensKind::DirectCalls, &common,
+                        OffsetStartColumn(loc, offset++), sym.usr,
                         false /*force_display*/);
-            if (!base_callers.empty())
-              AddCodeLens("base call", "base calls", &common,
-                          OffsetStartColumn(loc, offset++), base_callers,
+            if (base_callers)
+              AddCodeLens(LensKind::BaseCalls, &common,
+                          OffsetStartColumn(loc, offset++), sym.usr,
                           false /*force_display*/);
-            if (!derived_callers.empty())
-              AddCodeLens("derived call", "derived calls", &common,
-                          OffsetStartColumn(loc, offset++), derived_callers,
+            if (derived_callers)
+              AddCodeLens(LensKind::DerivedCalls, &common,
+                          OffsetStartColumn(loc, offset++), sym.usr,
                           false /*force_display*/);
           }
 
-          AddCodeLens("derived", "derived", &common,
-                      OffsetStartColumn(use, offset++),
-                      GetFuncDeclarations(db, func.derived),
+          AddCodeLens(LensKind::DerivedFuncs, &common,
+                      OffsetStartColumn(use, offset++), sym.usr,
                       false /*force_display*/);
 
           // "Base"
@@ -195,9 +328,8 @@ struct Handler_TextDocumentCodeLens
               }
             }
           } else {
-            AddCodeLens("base", "base", &common, OffsetStartColumn(use, 1),
-                        GetTypeDeclarations(db, def->bases),
-                        false /*force_display*/);
+            AddCodeLens(LensKind::BaseFuncs, &common, OffsetStartColumn(use, 1),
+                        sym.usr, false /*force_display*/);
           }
 
           break;
@@ -214,8 +346,8 @@ struct Handler_TextDocumentCodeLens
           if (def->kind == lsSymbolKind::Macro)
             force_display = false;
 
-          AddCodeLens("ref", "refs", &common, OffsetStartColumn(use, 0),
-                      var.uses, force_display);
+          AddCodeLens(LensKind::VarRefs, &common, OffsetStartColumn(use, 0),
+                      sym.usr, force_display);
           break;
         }
         case SymbolKind::File:
@@ -230,4 +362,16 @@ struct Handler_TextDocumentCodeLens
   }
 };
 REGISTER_MESSAGE_HANDLER(Handler_TextDocumentCodeLens);
+
+struct Handler_CodeLensResolve : BaseMessageHandler<In_CodeLensResolve> {
+  MethodType GetMethodType() const override { return kResolveMethodType; }
+  void Run(In_CodeLensResolve* request) override {
+    Out_CodeLensResolve out;
+    out.id = request->id;
+    out.result = std::move(request->params);
+    ResolveCodeLens(db, working_files, &out.result);
+    pipeline::WriteStdout(kResolveMethodType, out);
+  }
+};
+REGISTER_MESSAGE_HANDLER(Handler_CodeLensResolve);
 }  // namespace
@@ -343,17 +343,9 @@ struct Handler_TextDocumentCompletion : MessageHandler {
           FilterAndSortCompletionResponse(&out, result.keyword, has_open_paren);
         }
       } else if (result.keyword.compare("include") == 0) {
-        {
-          // do include completion
-          std::unique_lock<std::mutex> lock(
-              include_complete->completion_items_mutex, std::defer_lock);
-          if (include_complete->is_scanning)
-            lock.lock();
-          std::string quote = result.match[5];
-          for (auto& item : include_complete->completion_items)
-            if (quote.empty() || quote == (item.use_angle_brackets_ ? "<" : "\""))
-               out.result.items.push_back(item);
-        }
+        // do include completion
+        out.result.items =
+            include_complete->FindCandidates(result.pattern, result.match[5]);
         FilterAndSortCompletionResponse(&out, result.pattern, has_open_paren);
         DecorateIncludePaths(result.match, &out.result.items);
       }
@@ -29,7 +29,7 @@ struct Handler_TextDocumentDidChange
     }
     clang_complete->NotifyEdit(path);
     clang_complete->DiagnosticsUpdate(
-        request->params.textDocument.AsTextDocumentIdentifier());
+        request->params.textDocument.AsTextDocumentIdentifier(), true);
   }
 };
 REGISTER_MESSAGE_HANDLER(Handler_TextDocumentDidChange);
@@ -57,14 +57,16 @@ struct Handler_TextDocumentDidOpen
     if (SourceFileLanguage(path) != LanguageId::Unknown) {
       Project::Entry entry = project->FindCompilationEntryForFile(path);
       pipeline::Index(entry.filename,
-                      params.args.size() ? params.args : entry.args, true);
+                      params.args.size() ? CompileArgs(params.args)
+                                         : entry.args,
+                      true);
 
       clang_complete->FlushSession(entry.filename);
     }
 
     clang_complete->NotifyView(path);
     if (g_config->diagnostics.onParse)
-      clang_complete->DiagnosticsUpdate({params.textDocument.uri});
+      clang_complete->DiagnosticsUpdate({params.textDocument.uri}, false);
   }
 };
 REGISTER_MESSAGE_HANDLER(Handler_TextDocumentDidOpen);
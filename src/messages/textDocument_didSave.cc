@@ -2,6 +2,7 @@
 #include "message_handler.h"
 #include "project.h"
 #include "pipeline.hh"
+#include "utils.h"
 using namespace ccls;
 
 namespace {
@@ -46,6 +47,7 @@ struct Handler_TextDocumentDidSave
     //      mutex and check to see if we should skip the current request.
     //      if so, ignore that index response.
     // TODO: send as priority request
+    InvalidateWriteTimes();
     if (!g_config->index.onDidChange) {
       Project::Entry entry = project->FindCompilationEntryForFile(path);
       pipeline::Index(entry.filename, entry.args, true);
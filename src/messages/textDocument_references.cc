@@ -66,35 +66,29 @@ struct Handler_TextDocumentReferences
 
     for (SymbolRef sym : FindSymbolsAtLocation(wfile, file, params.position)) {
       // Found symbol. Return references.
-      std::unordered_set<Usr> seen;
-      seen.insert(sym.usr);
-      std::vector<Usr> stack{sym.usr};
-      if (sym.kind != SymbolKind::Func)
-        params.context.base = false;
-      while (stack.size()) {
-        sym.usr = stack.back();
-        stack.pop_back();
+      std::vector<Usr> usrs{sym.usr};
+      if (sym.kind == SymbolKind::Func && params.context.base &&
+          db->HasFunc(sym.usr))
+        for (DenseId id :
+             db->GetClosure(SymbolKind::Func, db->FuncId(sym.usr), false))
+          usrs.push_back(db->Func(id).usr);
+      // Collect the uses first so that they can be converted in bulk.
+      std::vector<Use> uses;
+      std::vector<lsSymbolKind> parent_kinds;
+      for (Usr usr : usrs) {
+        sym.usr = usr;
         auto fn = [&](Use use, lsSymbolKind parent_kind) {
           if (Role(use.role & params.context.role) == params.context.role &&
-              !(use.role & params.context.excludeRole))
-            if (std::optional<lsLocationEx> ls_loc =
-                    GetLsLocationEx(db, working_files, use, container)) {
-              if (container)
-                ls_loc->parentKind = parent_kind;
-              out.result.push_back(*ls_loc);
-            }
+              !(use.role & params.context.excludeRole)) {
+            uses.push_back(use);
+            parent_kinds.push_back(parent_kind);
+          }
         };
         WithEntity(db, sym, [&](const auto& entity) {
           lsSymbolKind parent_kind = lsSymbolKind::Unknown;
           for (auto& def : entity.def)
             if (def.spell) {
               parent_kind = GetSymbolKind(db, sym);
-              if (params.context.base)
-                for (Usr usr : def.GetBases())
-                  if (!seen.count(usr)) {
-                    seen.insert(usr);
-                    stack.push_back(usr);
-                  }
               break;
             }
           for (Use use : entity.uses)
@@ -108,6 +102,16 @@ struct Handler_TextDocumentReferences
           }
         });
       }
+      std::vector<std::optional<lsLocation>> locs =
+          GetLsLocations(db, working_files, uses);
+      for (size_t i = 0; i < uses.size(); i++)
+        if (locs[i]) {
+          lsLocationEx ls_loc =
+              GetLsLocationEx(db, uses[i], *locs[i], container);
+          if (container)
+            ls_loc.parentKind = parent_kinds[i];
+          out.result.push_back(std::move(ls_loc));
+        }
       break;
     }
 
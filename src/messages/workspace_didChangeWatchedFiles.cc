@@ -1,6 +1,7 @@
 #include "clang_complete.h"
 #include "message_handler.h"
 #include "project.h"
+#include "utils.h"
 #include "pipeline.hh"
 #include "working_files.h"
 using namespace ccls;
@@ -37,6 +38,7 @@ struct Handler_WorkspaceDidChangeWatchedFiles
     : BaseMessageHandler<In_WorkspaceDidChangeWatchedFiles> {
   MethodType GetMethodType() const override { return kMethodType; }
   void Run(In_WorkspaceDidChangeWatchedFiles* request) override {
+    InvalidateWriteTimes();
     for (lsFileEvent& event : request->params.changes) {
       std::string path = event.uri.GetPath();
       Project::Entry entry;
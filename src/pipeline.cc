@@ -2,6 +2,7 @@
 
 #include "clang_complete.h"
 #include "config.h"
+#include "file_watcher.hh"
 #include "include_complete.h"
 #include "log.hh"
 #include "lsp.h"
@@ -16,6 +17,7 @@
 #include <llvm/Support/Timer.h>
 using namespace llvm;
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 #ifndef _WIN32
@@ -25,7 +27,7 @@ using namespace llvm;
 void DiagnosticsPublisher::Init() {
   frequencyMs_ = g_config->diagnostics.frequencyMs;
   match_ = std::make_unique<GroupMatch>(g_config->diagnostics.whitelist,
-                                        g_config->diagnostics.blacklist);
+                                        g_config->diagnostics.blacklist, true);
 }
 
 void DiagnosticsPublisher::Publish(WorkingFiles* working_files,
@@ -61,7 +63,7 @@ namespace {
 
 struct Index_Request {
   std::string path;
-  std::vector<std::string> args;
+  CompileArgs args;
   bool is_interactive;
   lsRequestId id;
 };
@@ -78,9 +80,55 @@ ThreadedQueue<std::unique_ptr<InMessage>>* on_request;
 ThreadedQueue<Index_Request>* index_request;
 ThreadedQueue<IndexUpdate>* on_indexed;
 ThreadedQueue<Stdout_Request>* for_stdout;
+// Number of indexer threads in Indexer_Parse, which may hold interned strings.
+std::atomic<int> active_indexers;
+
+// Definitions removed from |db| leave their interned names, hovers and
+// comments behind. Once enough garbage may have accumulated, move the strings
+// still referenced by |db| to fresh storage while the indexers are idle.
+void CompactStrings(DB *db) {
+  InternStats stats = GetInternStats();
+  if (stats.bytes < std::max<uint64_t>(64 << 20, 2 * stats.live_bytes))
+    return;
+  bool compacted = CompactInterned(
+      [] { return active_indexers == 0 && on_indexed->Size() == 0; },
+      [&](llvm::function_ref<void(const char *&)> fn) {
+        auto visit = [&](auto &entities) {
+          for (auto &entity : entities)
+            for (auto &def : entity.def) {
+              fn(def.detailed_name);
+              fn(def.hover);
+              fn(def.comments);
+            }
+        };
+        visit(db->funcs);
+        visit(db->types);
+        visit(db->vars);
+      });
+  if (compacted)
+    LOG_S(INFO) << "compacted interned strings from " << stats.bytes << " to "
+                << GetInternStats().bytes << " bytes";
+}
+
+// With index.watch, records that the translation unit of |entry| depends on
+// |deps|, and watches them and the translation unit itself.
+template <typename Deps>
+void AddDependents(Project *project, const Project::Entry &entry,
+                   const Deps &deps) {
+  if (!g_config->index.watch)
+    return;
+  if (entry.id >= 0) {
+    std::lock_guard<std::mutex> lock(project->mutex_);
+    for (auto &dep : deps)
+      project->dependents_[dep.first().str()].insert(entry.id);
+  }
+  watcher::Watch(entry.filename);
+  for (auto &dep : deps)
+    watcher::Watch(dep.first().str());
+}
 
 bool CacheInvalid(VFS *vfs, IndexFile *prev, const std::string &path,
-                  const std::vector<std::string> &args,
+                  const CompileArgs &args,
                   const std::optional<std::string> &from) {
   {
     std::lock_guard<std::mutex> lock(vfs->mutex);
@@ -182,9 +230,21 @@ bool Indexer_Parse(DiagnosticsPublisher* diag_pub,
     if (CacheInvalid(vfs, prev.get(), path_to_index, entry.args, std::nullopt))
       reparse = 2;
     int reparseForDep = g_config->index.reparseForDependency;
-    if (reparseForDep > 1 || (reparseForDep == 1 && !Project::loaded))
+    if (reparseForDep > 1 || (reparseForDep == 1 && !Project::loaded)) {
+      std::vector<std::string> deps;
+      std::vector<std::optional<int64_t>> write_times;
+      for (const auto& dep : prev->dependencies)
+        deps.push_back(dep.first().str());
+      // While the project is loading, translation units sharing headers share
+      // their stats. Afterwards, headers may change at any time.
+      if (!Project::loaded)
+        CachedLastWriteTimes(deps, &write_times);
+      else
+        for (const std::string& dep : deps)
+          write_times.push_back(LastWriteTime(dep));
+      size_t i = 0;
       for (const auto& dep : prev->dependencies) {
-        if (auto write_time1 = LastWriteTime(dep.first().str())) {
+        if (auto write_time1 = write_times[i++]) {
           if (dep.second < *write_time1) {
             reparse = 2;
             std::lock_guard<std::mutex> lock(vfs->mutex);
@@ -193,11 +253,13 @@ bool Indexer_Parse(DiagnosticsPublisher* diag_pub,
         } else
           reparse = 2;
       }
+    }
   }
 
   if (reparse < 2) {
     LOG_S(INFO) << "load cache for " << path_to_index;
     auto dependencies = prev->dependencies;
+    AddDependents(project, entry, dependencies);
     if (reparse) {
       IndexUpdate update = IndexUpdate::CreateDelta(nullptr, prev.get());
       on_indexed->PushBack(std::move(update), request.is_interactive);
@@ -263,6 +325,7 @@ bool Indexer_Parse(DiagnosticsPublisher* diag_pub,
       for (auto& dep : curr->dependencies)
         project->absolute_path_to_entry_index_[dep.first()] = entry.id;
     }
+    AddDependents(project, entry, curr->dependencies);
 
     // Build delta update.
     IndexUpdate update = IndexUpdate::CreateDelta(prev.get(), curr.get());
@@ -292,9 +355,13 @@ void Indexer_Main(DiagnosticsPublisher* diag_pub,
                   VFS* vfs,
                   Project* project,
                   WorkingFiles* working_files) {
-  while (true)
-    if (!Indexer_Parse(diag_pub, working_files, project, vfs))
+  while (true) {
+    active_indexers++;
+    bool did_work = Indexer_Parse(diag_pub, working_files, project, vfs);
+    active_indexers--;
+    if (!did_work)
       indexer_waiter->Wait(index_request);
+  }
 }
 
 void Main_OnIndexed(DB* db,
@@ -303,9 +370,14 @@ void Main_OnIndexed(DB* db,
                     IndexUpdate* update) {
   if (update->refresh) {
     Project::loaded = true;
+    InvalidateWriteTimes();
     LOG_S(INFO) << "loaded project. Refresh semantic highlight for all working file.";
+    InternStats stats = GetInternStats();
+    LOG_S(INFO) << "interned " << stats.strings << " strings (" << stats.bytes
+                << " bytes) in " << stats.lookups << " lookups, "
+                << stats.contended << " contended";
     std::lock_guard<std::mutex> lock(working_files->files_mutex);
-    for (auto& f : working_files->files) {
+    for (auto& [_, f] : working_files->files) {
       std::string filename = LowerPathIfInsensitive(f->filename);
       if (db->name2file_id.find(filename) == db->name2file_id.end())
         continue;
@@ -467,6 +539,7 @@ void MainLoop() {
     }
 
     if (!did_work) {
+      CompactStrings(&db);
       FreeUnusedMemory();
       main_waiter->Wait(on_indexed, on_request);
     }
@@ -474,7 +547,7 @@ void MainLoop() {
 }
 
 void Index(const std::string& path,
-           const std::vector<std::string>& args,
+           const CompileArgs& args,
            bool interactive,
            lsRequestId id) {
   index_request->PushBack({path, args, interactive, id}, interactive);
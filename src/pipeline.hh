@@ -38,7 +38,7 @@ void Indexer_Main(DiagnosticsPublisher* diag_pub,
 void MainLoop();
 
 void Index(const std::string& path,
-           const std::vector<std::string>& args,
+           const CompileArgs& args,
            bool is_interactive,
            lsRequestId id = {});
 
@@ -17,17 +17,27 @@ using namespace ccls;
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Tooling/CompilationDatabase.h>
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/LineIterator.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/Threading.h>
 using namespace clang;
 using namespace llvm;
 
+#include <rapidjson/error/en.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
 
 #if defined(__unix__) || defined(__APPLE__)
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <limits>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -168,6 +178,194 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
   return result;
 }
 
+// Number of threads used to load the project.
+int LoaderThreads() {
+  int n = g_config->index.threads;
+  return n > 0 ? n : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs GetCompilationEntryFromCompileCommandEntry on worker threads while
+// entries are still being added. Each worker collects include directories in
+// its own ProjectConfig, which are merged by Finish.
+class ParallelEntryLoader {
+  ProjectConfig* config_;
+  std::vector<ProjectConfig> locals_;
+  std::vector<std::vector<std::pair<size_t, Project::Entry>>> outs_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_, not_full_;
+  std::deque<std::pair<size_t, CompileCommandsEntry>> pending_;
+  size_t added_ = 0;
+  bool done_ = false;
+
+  // Bounds the memory used by entries which have been parsed but not
+  // processed.
+  static constexpr size_t kMaxPending = 1024;
+
+  void Work(int i) {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [&] { return pending_.size() || done_; });
+      if (pending_.empty())
+        return;
+      auto item = std::move(pending_.front());
+      pending_.pop_front();
+      lock.unlock();
+      not_full_.notify_one();
+
+      CompileCommandsEntry& e = item.second;
+      if (e.args.empty() && e.command.size()) {
+        BumpPtrAllocator Alloc;
+        StringSaver Saver(Alloc);
+        SmallVector<const char*, 64> Argv;
+#ifdef _WIN32
+        cl::TokenizeWindowsCommandLine(e.command, Saver, Argv);
+#else
+        cl::TokenizeGNUCommandLine(e.command, Saver, Argv);
+#endif
+        e.args.assign(Argv.begin(), Argv.end());
+      }
+      outs_[i].emplace_back(
+          item.first, GetCompilationEntryFromCompileCommandEntry(&locals_[i], e));
+    }
+  }
+
+public:
+  ParallelEntryLoader(ProjectConfig* config) : config_(config) {
+    int n = LoaderThreads();
+    locals_.assign(n, *config);
+    outs_.resize(n);
+    for (int i = 0; i < n; i++)
+      workers_.emplace_back([this, i]() {
+        set_thread_name("loader" + Twine(i));
+        Work(i);
+      });
+  }
+
+  ~ParallelEntryLoader() {
+    if (workers_.size())
+      Finish();
+  }
+
+  void Add(CompileCommandsEntry&& e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [&] { return pending_.size() < kMaxPending; });
+    pending_.emplace_back(added_++, std::move(e));
+    lock.unlock();
+    not_empty_.notify_one();
+  }
+
+  // Waits for the workers and returns the entries in the order they were
+  // added.
+  std::vector<Project::Entry> Finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    not_empty_.notify_all();
+    for (std::thread& worker : workers_)
+      worker.join();
+    workers_.clear();
+
+    std::vector<std::pair<size_t, Project::Entry>> all;
+    all.reserve(added_);
+    for (auto& out : outs_)
+      for (auto& item : out)
+        all.push_back(std::move(item));
+    std::sort(all.begin(), all.end(), [](const auto& l, const auto& r) {
+      return l.first < r.first;
+    });
+    std::vector<Project::Entry> result;
+    result.reserve(all.size());
+    for (auto& item : all)
+      result.push_back(std::move(item.second));
+    for (ProjectConfig& local : locals_) {
+      config_->quote_dirs.insert(local.quote_dirs.begin(),
+                                 local.quote_dirs.end());
+      config_->angle_dirs.insert(local.angle_dirs.begin(),
+                                 local.angle_dirs.end());
+    }
+    return result;
+  }
+};
+
+// SAX handler for compile_commands.json. Each command is passed to |loader|
+// as soon as its object ends, so the database is never held as a DOM.
+struct CompileCommandsHandler
+    : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CompileCommandsHandler> {
+  ParallelEntryLoader* loader;
+  CompileCommandsEntry entry;
+  std::string key;
+  int depth = 0;
+  bool in_arguments = false;
+
+  CompileCommandsHandler(ParallelEntryLoader* loader) : loader(loader) {}
+
+  bool String(const char* str, rapidjson::SizeType len, bool) {
+    if (in_arguments)
+      entry.args.emplace_back(str, len);
+    else if (depth == 2) {
+      if (key == "directory")
+        entry.directory.assign(str, len);
+      else if (key == "file")
+        entry.file.assign(str, len);
+      else if (key == "command")
+        entry.command.assign(str, len);
+    }
+    return true;
+  }
+  bool Key(const char* str, rapidjson::SizeType len, bool) {
+    if (depth == 2)
+      key.assign(str, len);
+    return true;
+  }
+  bool StartObject() {
+    depth++;
+    return true;
+  }
+  bool EndObject(rapidjson::SizeType) {
+    if (--depth == 1) {
+      if (entry.file.size()) {
+        entry.file = entry.ResolveIfRelative(entry.file);
+        loader->Add(std::move(entry));
+      }
+      entry = CompileCommandsEntry();
+    }
+    return true;
+  }
+  bool StartArray() {
+    if (++depth == 3 && key == "arguments")
+      in_arguments = true;
+    return true;
+  }
+  bool EndArray(rapidjson::SizeType) {
+    if (depth-- == 3)
+      in_arguments = false;
+    return true;
+  }
+};
+
+// Returns false if |path| cannot be opened.
+bool LoadCompileCommandsJson(ProjectConfig* project, const char* path,
+                             std::vector<Project::Entry>* result) {
+  FILE* fin = fopen(path, "rb");
+  if (!fin)
+    return false;
+  ParallelEntryLoader loader(project);
+  CompileCommandsHandler handler(&loader);
+  char buf[65536];
+  rapidjson::FileReadStream stream(fin, buf, sizeof buf);
+  rapidjson::Reader reader;
+  rapidjson::ParseResult ok =
+      reader.Parse<rapidjson::kParseIterativeFlag>(stream, handler);
+  fclose(fin);
+  *result = loader.Finish();
+  LOG_IF_S(WARNING, !ok) << "failed to parse " << path << ": "
+                         << rapidjson::GetParseError_En(ok.Code()) << " ("
+                         << ok.Offset() << ")";
+  return true;
+}
+
 std::vector<std::string> ReadCompilerArgumentsFromFile(
     const std::string& path) {
   auto MBOrErr = MemoryBuffer::getFile(path);
@@ -191,17 +389,32 @@ std::vector<Project::Entry> LoadFromDirectoryListing(ProjectConfig* config) {
   std::unordered_map<std::string, std::vector<std::string>> folder_args;
   std::vector<std::string> files;
 
-  GetFilesInFolder(config->project_dir, true /*recursive*/,
-                   true /*add_folder_to_path*/,
-                   [&folder_args, &files](const std::string& path) {
-                     if (SourceFileLanguage(path) != LanguageId::Unknown) {
-                       files.push_back(path);
-                     } else if (sys::path::filename(path) == ".ccls") {
-                       LOG_S(INFO) << "Using .ccls arguments from " << path;
-                       folder_args.emplace(sys::path::parent_path(path),
-                                           ReadCompilerArgumentsFromFile(path));
-                     }
-                   });
+  // Directories matching index.blacklist are pruned, unless index.whitelist
+  // is non-empty and might select files inside them.
+  GroupMatch blacklist({}, g_config->index.blacklist);
+  bool prune = g_config->index.whitelist.empty();
+  DirListingCache dir_cache, visited;
+  std::string dir_cache_path = g_config->cacheDirectory +
+                               EscapeFileName(config->project_dir) +
+                               "@dirs.json";
+  LoadDirListingCache(dir_cache_path, &dir_cache);
+  WalkFolder(config->project_dir, LoaderThreads(),
+             [&](const std::string& dir) {
+               return prune && !blacklist.IsMatch(dir);
+             },
+             dir_cache, &visited,
+             [&folder_args, &files](const std::string& path) {
+               if (SourceFileLanguage(path) != LanguageId::Unknown) {
+                 files.push_back(path);
+               } else if (sys::path::filename(path) == ".ccls") {
+                 LOG_S(INFO) << "Using .ccls arguments from " << path;
+                 folder_args.emplace(sys::path::parent_path(path),
+                                     ReadCompilerArgumentsFromFile(path));
+               }
+             });
+  SaveDirListingCache(dir_cache_path, visited);
+  // Directories are visited in parallel. Keep the order stable across runs.
+  std::sort(files.begin(), files.end());
 
   const std::string& project_dir = config->project_dir;
   const auto& project_dir_args = folder_args[project_dir];
@@ -222,6 +435,7 @@ std::vector<Project::Entry> LoadFromDirectoryListing(ProjectConfig* config) {
     return folder_args[project_dir];
   };
 
+  ParallelEntryLoader loader(config);
   for (const std::string& file : files) {
     CompileCommandsEntry e;
     e.directory = config->project_dir;
@@ -230,10 +444,10 @@ std::vector<Project::Entry> LoadFromDirectoryListing(ProjectConfig* config) {
     if (e.args.empty())
       e.args.push_back("%clang");  // Add a Dummy.
     e.args.push_back(e.file);
-    result.push_back(GetCompilationEntryFromCompileCommandEntry(config, e));
+    loader.Add(std::move(e));
   }
 
-  return result;
+  return loader.Finish();
 }
 
 std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
@@ -278,9 +492,14 @@ std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
 #endif
   }
 
+  // compile_commands.json is parsed in a streaming manner. Other formats,
+  // e.g. compile_flags.txt, are left to clang::tooling.
+  std::vector<Project::Entry> result;
   std::string err_msg;
-  std::unique_ptr<tooling::CompilationDatabase> CDB =
-      tooling::CompilationDatabase::loadFromDirectory(comp_db_dir, err_msg);
+  std::unique_ptr<tooling::CompilationDatabase> CDB;
+  bool streamed = LoadCompileCommandsJson(project, Path.c_str(), &result);
+  if (!streamed)
+    CDB = tooling::CompilationDatabase::loadFromDirectory(comp_db_dir, err_msg);
   if (!g_config->compilationDatabaseCommand.empty()) {
 #ifdef _WIN32
   // TODO
@@ -289,23 +508,26 @@ std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
     rmdir(comp_db_dir.c_str());
 #endif
   }
+  if (streamed) {
+    LOG_S(INFO) << "loaded " << Path.c_str();
+    return result;
+  }
   if (!CDB) {
     LOG_S(WARNING) << "failed to load " << Path.c_str() << " " << err_msg;
     return {};
   }
 
-  LOG_S(INFO) << "loaded " << Path.c_str();
+  LOG_S(INFO) << "loaded " << comp_db_dir;
 
-  std::vector<Project::Entry> result;
+  ParallelEntryLoader loader(project);
   for (tooling::CompileCommand &Cmd : CDB->getAllCompileCommands()) {
     CompileCommandsEntry entry;
     entry.directory = std::move(Cmd.Directory);
     entry.file = entry.ResolveIfRelative(Cmd.Filename);
     entry.args = std::move(Cmd.CommandLine);
-    result.push_back(
-        GetCompilationEntryFromCompileCommandEntry(project, entry));
+    loader.Add(std::move(entry));
   }
-  return result;
+  return loader.Finish();
 }
 
 // Computes a score based on how well |a| and |b| match. This is used for
@@ -323,6 +545,25 @@ int ComputeGuessScore(std::string_view a, std::string_view b) {
   return score;
 }
 
+const size_t kMaxDeepCandidates = 16;
+
+void AddToDirIndex(
+    std::unordered_map<std::string, Project::DirCandidates>& dir2candidates,
+    const std::string& filename, int i) {
+  int depth = 0;
+  for (size_t pos = filename.rfind('/'); pos != std::string::npos;
+       pos = pos ? filename.rfind('/', pos - 1) : std::string::npos, depth++) {
+    auto it = dir2candidates.try_emplace(filename.substr(0, pos + 1)).first;
+    Project::DirCandidates& c = it->second;
+    if (c.entries.empty() || depth < c.depth) {
+      c.depth = depth;
+      c.entries.assign(1, i);
+    } else if (depth == c.depth &&
+               (depth == 0 || c.entries.size() < kMaxDeepCandidates)) {
+      c.entries.push_back(i);
+    }
+  }
+}
 }  // namespace
 
 bool Project::loaded = false;
@@ -353,9 +594,13 @@ void Project::Load(const std::string& root_directory) {
   // Setup project entries.
   std::lock_guard<std::mutex> lock(mutex_);
   absolute_path_to_entry_index_.reserve(entries.size());
+  dir2candidates_.clear();
+  dependents_.clear();
+  inferred_.clear();
   for (size_t i = 0; i < entries.size(); ++i) {
     entries[i].id = i;
     absolute_path_to_entry_index_[entries[i].filename] = i;
+    AddToDirIndex(dir2candidates_, entries[i].filename, i);
   }
 }
 
@@ -374,43 +619,62 @@ void Project::SetFlagsForFile(
     entry.filename = path;
     entry.args = flags;
     this->entries.emplace_back(entry);
+    AddToDirIndex(dir2candidates_, path, int(entries.size()) - 1);
+    inferred_.clear();
   }
 }
 
 Project::Entry Project::FindCompilationEntryForFile(
     const std::string& filename) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = absolute_path_to_entry_index_.find(filename);
-    if (it != absolute_path_to_entry_index_.end())
-      return entries[it->second];
-  }
-
-  // We couldn't find the file. Try to infer it.
-  // TODO: Cache inferred file in a separate array (using a lock or similar)
-  Entry* best_entry = nullptr;
-  int best_score = std::numeric_limits<int>::min();
-  for (Entry& entry : entries) {
-    int score = ComputeGuessScore(filename, entry.filename);
-    if (score > best_score) {
-      best_score = score;
-      best_entry = &entry;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = absolute_path_to_entry_index_.find(filename);
+  if (it != absolute_path_to_entry_index_.end())
+    return entries[it->second];
+
+  // We couldn't find the file. Try to infer it from the entries closest to
+  // its nearest ancestor directory which has any.
+  const Entry* best_entry = nullptr;
+  auto it1 = inferred_.find(filename);
+  if (it1 != inferred_.end()) {
+    if (it1->second >= 0)
+      best_entry = &entries[it1->second];
+  } else {
+    int best = -1, best_score = std::numeric_limits<int>::min();
+    for (size_t pos = filename.rfind('/'); pos != std::string::npos;
+         pos = pos ? filename.rfind('/', pos - 1) : std::string::npos) {
+      auto it2 = dir2candidates_.find(filename.substr(0, pos + 1));
+      if (it2 == dir2candidates_.end())
+        continue;
+      for (int i : it2->second.entries) {
+        int score = ComputeGuessScore(filename, entries[i].filename);
+        if (score > best_score) {
+          best_score = score;
+          best = i;
+        }
+      }
+      break;
     }
+    if (best < 0 && entries.size())
+      best = 0;
+    inferred_[filename] = best;
+    if (best >= 0)
+      best_entry = &entries[best];
   }
 
   Project::Entry result;
   result.is_inferred = true;
   result.filename = filename;
+  std::vector<std::string> args;
   if (!best_entry) {
-    result.args.push_back("%clang");
-    result.args.push_back(filename);
+    args.push_back("%clang");
+    args.push_back(filename);
   } else {
-    result.args = best_entry->args;
+    args = best_entry->args.ToVector();
 
     // |best_entry| probably has its own path in the arguments. We need to remap
     // that path to the new filename.
     std::string best_entry_base_name = sys::path::filename(best_entry->filename);
-    for (std::string& arg : result.args) {
+    for (std::string& arg : args) {
       try {
         if (arg == best_entry->filename ||
             sys::path::filename(arg) == best_entry_base_name)
@@ -419,6 +683,7 @@ Project::Entry Project::FindCompilationEntryForFile(
       }
     }
   }
+  result.args = args;
 
   return result;
 }
@@ -440,6 +705,8 @@ void Project::ForAllFilteredFiles(
 
 void Project::Index(WorkingFiles* wfiles,
                     lsRequestId id) {
+  // Dependencies may have changed since the last bulk index.
+  InvalidateWriteTimes();
   ForAllFilteredFiles([&](int i, const Project::Entry& entry) {
     bool is_interactive = wfiles->GetFileByFilename(entry.filename) != nullptr;
     pipeline::Index(entry.filename, entry.args, is_interactive, id);
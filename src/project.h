@@ -7,6 +7,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 struct WorkingFiles;
@@ -15,7 +16,7 @@ struct Project {
   struct Entry {
     std::string directory;
     std::string filename;
-    std::vector<std::string> args;
+    ccls::CompileArgs args;
     // If true, this entry is inferred and was not read from disk.
     bool is_inferred = false;
     int id = -1;
@@ -30,6 +31,23 @@ struct Project {
   std::mutex mutex_;
   std::unordered_map<std::string, int> absolute_path_to_entry_index_;
 
+  // Candidates for inferring the entry of a file not in |entries|, keyed by
+  // directory (ending with '/'): the entries closest below the directory.
+  // Entries directly in the directory are all kept; deeper ones are capped.
+  struct DirCandidates {
+    int depth = 0;
+    std::vector<int> entries;
+  };
+  std::unordered_map<std::string, DirCandidates> dir2candidates_;
+  // Indices of the entries whose translation units include each file, for
+  // ccls::watcher. Only filled with index.watch. Edges are added when a file
+  // is indexed or loaded from cache. Cleared by Load because the entry
+  // indices change.
+  std::unordered_map<std::string, std::unordered_set<int>> dependents_;
+  // Inferred entry index of files looked up by FindCompilationEntryForFile.
+  // Cleared whenever |entries| changes.
+  std::unordered_map<std::string, int> inferred_;
+
   // Loads a project for the given |directory|.
   //
   // If |config->compilationDatabaseDirectory| is not empty, look for .ccls or
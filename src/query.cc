@@ -4,6 +4,7 @@
 #include "serializer.h"
 #include "serializers/json.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <functional>
@@ -53,10 +54,19 @@ void AddRange(std::vector<Use>& into, const std::vector<Use>& from) {
     into.push_back(use);
 }
 
-void AddRange(std::vector<Usr>& into, const std::vector<Usr>& from) {
+void AddRange(std::vector<DenseId>& into, const std::vector<DenseId>& from) {
   into.insert(into.end(), from.begin(), from.end());
 }
 
+template <typename Q>
+DenseId GetOrCreateId(llvm::DenseMap<WrappedUsr, int>& entity_usr,
+                      std::vector<Q>& entities, Usr usr) {
+  auto R = entity_usr.try_emplace({usr}, entity_usr.size());
+  if (R.second)
+    entities.emplace_back().usr = usr;
+  return DenseId(R.first->second);
+}
+
 template <typename T>
 void RemoveRange(std::vector<T>& from, const std::vector<T>& to_remove) {
   if (to_remove.size()) {
@@ -86,8 +96,7 @@ QueryFile::DefUpdate BuildFileDefUpdate(const IndexFile& indexed) {
     def.outline.push_back(SymbolRef{{use.range, usr, kind, use.role}});
   };
 
-  for (auto& it : indexed.usr2type) {
-    const IndexType& type = it.second;
+  for (const IndexType& type : indexed.usr2type) {
     if (type.def.spell)
       add_all_symbols(*type.def.spell, type.usr, SymbolKind::Type);
     if (type.def.extent)
@@ -103,8 +112,7 @@ QueryFile::DefUpdate BuildFileDefUpdate(const IndexFile& indexed) {
       if (use.file_id == -1)
         add_all_symbols(use, type.usr, SymbolKind::Type);
   }
-  for (auto& it: indexed.usr2func) {
-    const IndexFunc& func = it.second;
+  for (const IndexFunc& func : indexed.usr2func) {
     if (func.def.spell)
       add_all_symbols(*func.def.spell, func.usr, SymbolKind::Func);
     if (func.def.extent)
@@ -127,8 +135,7 @@ QueryFile::DefUpdate BuildFileDefUpdate(const IndexFile& indexed) {
         add_all_symbols(use, func.usr, SymbolKind::Func);
       }
   }
-  for (auto& it : indexed.usr2var) {
-    const IndexVar& var = it.second;
+  for (const IndexVar& var : indexed.usr2var) {
     if (var.def.spell)
       add_all_symbols(*var.def.spell, var.usr, SymbolKind::Var);
     if (var.def.extent)
@@ -180,26 +187,23 @@ IndexUpdate IndexUpdate::CreateDelta(IndexFile* previous,
   r.files_def_update = BuildFileDefUpdate(std::move(*current));
 
   r.funcs_hint = current->usr2func.size() - previous->usr2func.size();
-  for (auto& it : previous->usr2func) {
-    auto& func = it.second;
+  for (IndexFunc& func : previous->usr2func) {
     if (func.def.detailed_name[0])
       r.funcs_removed.push_back(func.usr);
     r.funcs_declarations[func.usr].first = std::move(func.declarations);
     r.funcs_uses[func.usr].first = std::move(func.uses);
     r.funcs_derived[func.usr].first = std::move(func.derived);
   }
-  for (auto& it : current->usr2func) {
-    auto& func = it.second;
+  for (IndexFunc& func : current->usr2func) {
     if (func.def.detailed_name[0])
-      r.funcs_def_update.emplace_back(it.first, func.def);
+      r.funcs_def_update.emplace_back(func.usr, func.def);
     r.funcs_declarations[func.usr].second = std::move(func.declarations);
     r.funcs_uses[func.usr].second = std::move(func.uses);
     r.funcs_derived[func.usr].second = std::move(func.derived);
   }
 
   r.types_hint = current->usr2type.size() - previous->usr2type.size();
-  for (auto& it : previous->usr2type) {
-    auto& type = it.second;
+  for (IndexType& type : previous->usr2type) {
     if (type.def.detailed_name[0])
       r.types_removed.push_back(type.usr);
     r.types_declarations[type.usr].first = std::move(type.declarations);
@@ -207,10 +211,9 @@ IndexUpdate IndexUpdate::CreateDelta(IndexFile* previous,
     r.types_derived[type.usr].first = std::move(type.derived);
     r.types_instances[type.usr].first = std::move(type.instances);
   };
-  for (auto& it : current->usr2type) {
-    auto& type = it.second;
+  for (IndexType& type : current->usr2type) {
     if (type.def.detailed_name[0])
-      r.types_def_update.emplace_back(it.first, type.def);
+      r.types_def_update.emplace_back(type.usr, type.def);
     r.types_declarations[type.usr].second = std::move(type.declarations);
     r.types_uses[type.usr].second = std::move(type.uses);
     r.types_derived[type.usr].second = std::move(type.derived);
@@ -218,17 +221,15 @@ IndexUpdate IndexUpdate::CreateDelta(IndexFile* previous,
   };
 
   r.vars_hint = current->usr2var.size() - previous->usr2var.size();
-  for (auto& it : previous->usr2var) {
-    auto& var = it.second;
+  for (IndexVar& var : previous->usr2var) {
     if (var.def.detailed_name[0])
       r.vars_removed.push_back(var.usr);
     r.vars_declarations[var.usr].first = std::move(var.declarations);
     r.vars_uses[var.usr].first = std::move(var.uses);
   }
-  for (auto& it : current->usr2var) {
-    auto& var = it.second;
+  for (IndexVar& var : current->usr2var) {
     if (var.def.detailed_name[0])
-      r.vars_def_update.emplace_back(it.first, var.def);
+      r.vars_def_update.emplace_back(var.usr, var.def);
     r.vars_declarations[var.usr].second = std::move(var.declarations);
     r.vars_uses[var.usr].second = std::move(var.uses);
   }
@@ -284,6 +285,10 @@ void DB::RemoveUsrs(SymbolKind kind,
   }
 }
 
+DenseId DB::FuncId(Usr usr) { return GetOrCreateId(func_usr, funcs, usr); }
+DenseId DB::TypeId(Usr usr) { return GetOrCreateId(type_usr, types, usr); }
+DenseId DB::VarId(Usr usr) { return GetOrCreateId(var_usr, vars, usr); }
+
 void DB::ApplyIndexUpdate(IndexUpdate *u) {
 #define REMOVE_ADD(C, F)                                                       \
   for (auto &it : u->C##s_##F) {                                               \
@@ -296,6 +301,20 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
     AssignFileId(lid2file_id, u->file_id, it.second.second);                   \
     AddRange(entity.F, it.second.second);                                      \
   }
+  // Like REMOVE_ADD, but the Usr edges are translated to DenseId of kind T.
+  // This may create entities, so |entity| is looked up afterwards.
+#define REMOVE_ADD_ID(C, F, T)                                                 \
+  for (auto &it : u->C##s_##F) {                                               \
+    std::vector<DenseId> removed, added;                                       \
+    for (Usr usr : it.second.first)                                            \
+      removed.push_back(T##Id(usr));                                           \
+    for (Usr usr : it.second.second)                                           \
+      added.push_back(T##Id(usr));                                             \
+    DenseId id = GetOrCreateId(C##_usr, C##s, it.first);                       \
+    auto &entity = C##s[uint32_t(id)];                                         \
+    RemoveRange(entity.F, removed);                                            \
+    AddRange(entity.F, added);                                                 \
+  }
 
   std::unordered_map<int, int> prev_lid2file_id, lid2file_id;
   for (auto & [ lid, path ] : u->prev_lid2path)
@@ -306,10 +325,7 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
   auto UpdateUses = [&](Usr usr, SymbolKind kind,
                         llvm::DenseMap<WrappedUsr, int> &entity_usr,
                         auto &entities, auto &p) {
-    auto R = entity_usr.try_emplace({usr}, entity_usr.size());
-    if (R.second)
-      vars.emplace_back().usr = usr;
-    auto &entity = entities[R.first->second];
+    auto &entity = entities[uint32_t(GetOrCreateId(entity_usr, entities, usr))];
     for (Use &use : p.first) {
       if (use.file_id == -1)
         use.file_id = u->file_id;
@@ -332,12 +348,52 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
     AddRange(entity.uses, p.second);
   };
 
-  if (u->files_removed)
-    files[name2file_id[LowerPathIfInsensitive(*u->files_removed)]].def =
-        std::nullopt;
+  if (u->files_removed) {
+    int file_id = name2file_id[LowerPathIfInsensitive(*u->files_removed)];
+    files[file_id].def = std::nullopt;
+    SetDependencies(file_id, {});
+  }
   u->file_id =
       u->files_def_update ? Update(std::move(*u->files_def_update)) : -1;
 
+  // Cached closures stay valid unless the bases of a definition in this file
+  // or a derived list changes. Bases are compared by an order-independent
+  // hash of the definitions removed from and added to this file, so
+  // |u->file_id| must be resolved first.
+  auto hash_bases = [](size_t &h, Usr usr, const std::vector<Usr> &bases) {
+    if (bases.size()) {
+      size_t h1 = std::hash<Usr>()(usr);
+      for (Usr base : bases)
+        hash_combine(h1, base);
+      h += h1;
+    }
+  };
+  size_t func_bases[2] = {}, type_bases[2] = {};
+  for (Usr usr : u->funcs_removed)
+    if (HasFunc(usr))
+      for (auto &def : Func(usr).def)
+        if (def.file_id == u->file_id)
+          hash_bases(func_bases[0], usr, def.bases);
+  for (auto &[usr, def] : u->funcs_def_update)
+    hash_bases(func_bases[1], usr, def.bases);
+  for (Usr usr : u->types_removed)
+    if (HasType(usr))
+      for (auto &def : Type(usr).def)
+        if (def.file_id == u->file_id)
+          hash_bases(type_bases[0], usr, def.bases);
+  for (auto &[usr, def] : u->types_def_update)
+    hash_bases(type_bases[1], usr, def.bases);
+  auto edges_changed = [](const UsrUpdate &update) {
+    for (auto &it : update)
+      if (it.second.first != it.second.second)
+        return true;
+    return false;
+  };
+  bool func_changed = func_bases[0] != func_bases[1] ||
+                      edges_changed(u->funcs_derived),
+       type_changed = type_bases[0] != type_bases[1] ||
+                      edges_changed(u->types_derived);
+
   const double grow = 1.3;
   size_t t;
 
@@ -349,7 +405,7 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
   RemoveUsrs(SymbolKind::Func, u->file_id, u->funcs_removed);
   Update(lid2file_id, u->file_id, std::move(u->funcs_def_update));
   REMOVE_ADD(func, declarations);
-  REMOVE_ADD(func, derived);
+  REMOVE_ADD_ID(func, derived, Func);
   for (auto & [ usr, p ] : u->funcs_uses)
     UpdateUses(usr, SymbolKind::Func, func_usr, funcs, p);
 
@@ -361,8 +417,8 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
   RemoveUsrs(SymbolKind::Type, u->file_id, u->types_removed);
   Update(lid2file_id, u->file_id, std::move(u->types_def_update));
   REMOVE_ADD(type, declarations);
-  REMOVE_ADD(type, derived);
-  REMOVE_ADD(type, instances);
+  REMOVE_ADD_ID(type, derived, Type);
+  REMOVE_ADD_ID(type, instances, Var);
   for (auto & [ usr, p ] : u->types_uses)
     UpdateUses(usr, SymbolKind::Type, type_usr, types, p);
 
@@ -378,6 +434,12 @@ void DB::ApplyIndexUpdate(IndexUpdate *u) {
     UpdateUses(usr, SymbolKind::Var, var_usr, vars, p);
 
 #undef REMOVE_ADD
+#undef REMOVE_ADD_ID
+
+  if (func_changed)
+    func_closures.clear();
+  if (type_changed)
+    type_closures.clear();
 }
 
 int DB::GetFileId(const std::string& path) {
@@ -389,9 +451,38 @@ int DB::GetFileId(const std::string& path) {
   return it.first->second;
 }
 
+void DB::SetDependencies(int file_id, std::vector<int> deps) {
+  std::sort(deps.begin(), deps.end());
+  deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+  std::vector<int> &old = files[file_id].dependencies;
+  if (old == deps)
+    return;
+  // Only edges in the symmetric difference touch other files.
+  auto i = old.begin(), j = deps.begin();
+  while (i != old.end() || j != deps.end())
+    if (j == deps.end() || (i != old.end() && *i < *j)) {
+      std::vector<int> &rdeps = files[*i++].dependents;
+      auto it = std::lower_bound(rdeps.begin(), rdeps.end(), file_id);
+      if (it != rdeps.end() && *it == file_id)
+        rdeps.erase(it);
+    } else if (i == old.end() || *j < *i) {
+      std::vector<int> &rdeps = files[*j++].dependents;
+      auto it = std::lower_bound(rdeps.begin(), rdeps.end(), file_id);
+      if (it == rdeps.end() || *it != file_id)
+        rdeps.insert(it, file_id);
+    } else
+      i++, j++;
+  files[file_id].dependencies = std::move(deps);
+}
+
 int DB::Update(QueryFile::DefUpdate&& u) {
   int file_id = GetFileId(u.first.path);
+  std::vector<int> deps;
+  deps.reserve(u.first.dependencies.size());
+  for (const std::string &dep : u.first.dependencies)
+    deps.push_back(GetFileId(dep));
   files[file_id].def = u.first;
+  SetDependencies(file_id, std::move(deps));
   return file_id;
 }
 
@@ -414,6 +505,50 @@ void DB::Update(const Lid2file_id &lid2file_id, int file_id,
   }
 }
 
+namespace {
+template <typename Q>
+void CollectClosure(std::vector<Q> &entities,
+                    llvm::DenseMap<WrappedUsr, int> &entity_usr, DenseId root,
+                    bool derived, std::vector<DenseId> &ret) {
+  std::unordered_set<uint32_t> seen{uint32_t(root)};
+  std::vector<DenseId> stack{root};
+  auto visit = [&](DenseId id) {
+    if (seen.insert(uint32_t(id)).second) {
+      ret.push_back(id);
+      stack.push_back(id);
+    }
+  };
+  while (stack.size()) {
+    Q &entity = entities[uint32_t(stack.back())];
+    stack.pop_back();
+    if (derived) {
+      for (DenseId id : entity.derived)
+        visit(id);
+    } else if (auto *def = entity.AnyDef()) {
+      for (Usr usr : def->bases) {
+        auto it = entity_usr.find({usr});
+        if (it != entity_usr.end())
+          visit(DenseId(it->second));
+      }
+    }
+  }
+}
+} // namespace
+
+const std::vector<DenseId> &DB::GetClosure(SymbolKind kind, DenseId id,
+                                           bool derived) {
+  bool func = kind == SymbolKind::Func;
+  auto [it, inserted] = (func ? func_closures : type_closures)
+                            .try_emplace(uint64_t(id) << 1 | derived);
+  if (inserted) {
+    if (func)
+      CollectClosure(funcs, func_usr, id, derived, it->second);
+    else
+      CollectClosure(types, type_usr, id, derived, it->second);
+  }
+  return it->second;
+}
+
 void DB::Update(const Lid2file_id &lid2file_id, int file_id,
                 std::vector<std::pair<Usr, QueryType::Def>> &&us) {
   for (auto &u : us) {
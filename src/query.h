@@ -9,7 +9,7 @@
 struct QueryFile {
   struct Def {
     std::string path;
-    std::vector<std::string> args;
+    ccls::CompileArgs args;
     LanguageId language;
     // Includes in the file.
     std::vector<IndexInclude> includes;
@@ -28,6 +28,9 @@ struct QueryFile {
   int id = -1;
   std::optional<Def> def;
   std::unordered_map<SymbolRef, int> symbol2refcnt;
+  // File ids of |def->dependencies| and of files which list this file as a
+  // dependency, both sorted. Maintained by DB::SetDependencies.
+  std::vector<int> dependencies, dependents;
 };
 
 template <typename Q, typename QDef>
@@ -45,6 +48,10 @@ struct QueryEntity {
   const Def* AnyDef() const { return const_cast<QueryEntity*>(this)->AnyDef(); }
 };
 
+// Index into DB::funcs, DB::types or DB::vars. Edges maintained by DB store
+// these instead of Usr, so traversals do not need hash lookups.
+enum class DenseId : uint32_t {};
+
 using UseUpdate =
     std::unordered_map<Usr, std::pair<std::vector<Use>, std::vector<Use>>>;
 using UsrUpdate =
@@ -55,7 +62,7 @@ struct QueryFunc : QueryEntity<QueryFunc, FuncDef> {
   llvm::SmallVector<Def, 1> def;
   std::vector<Use> declarations;
   std::vector<Use> uses;
-  std::vector<Usr> derived;
+  std::vector<DenseId> derived;
 };
 
 struct QueryType : QueryEntity<QueryType, TypeDef> {
@@ -63,8 +70,8 @@ struct QueryType : QueryEntity<QueryType, TypeDef> {
   llvm::SmallVector<Def, 1> def;
   std::vector<Use> declarations;
   std::vector<Use> uses;
-  std::vector<Usr> derived;
-  std::vector<Usr> instances;
+  std::vector<DenseId> derived;
+  std::vector<DenseId> instances;
 };
 
 struct QueryVar : QueryEntity<QueryVar, VarDef> {
@@ -139,11 +146,15 @@ struct DB {
   std::vector<QueryFunc> funcs;
   std::vector<QueryType> types;
   std::vector<QueryVar> vars;
+  // See GetClosure. Keyed by DenseId << 1 | derived.
+  llvm::DenseMap<uint64_t, std::vector<DenseId>> func_closures, type_closures;
 
   void RemoveUsrs(SymbolKind kind, int file_id, const std::vector<Usr>& to_remove);
   // Insert the contents of |update| into |db|.
   void ApplyIndexUpdate(IndexUpdate* update);
   int GetFileId(const std::string& path);
+  // Replaces the dependency edges of |file_id| and updates the reverse edges.
+  void SetDependencies(int file_id, std::vector<int> deps);
   int Update(QueryFile::DefUpdate&& u);
   void Update(const Lid2file_id &, int file_id,
               std::vector<std::pair<Usr, QueryType::Def>> &&us);
@@ -151,6 +162,11 @@ struct DB {
               std::vector<std::pair<Usr, QueryFunc::Def>> &&us);
   void Update(const Lid2file_id &, int file_id,
               std::vector<std::pair<Usr, QueryVar::Def>> &&us);
+  // Transitive bases (or derived) of a func or type, excluding itself, in
+  // depth-first order. Cached until an update changes bases or derived of
+  // that kind.
+  const std::vector<DenseId> &GetClosure(SymbolKind kind, DenseId id,
+                                         bool derived);
   std::string_view GetSymbolName(SymbolIdx sym, bool qualified);
 
   bool HasFunc(Usr usr) const { return func_usr.count({usr}); }
@@ -160,6 +176,13 @@ struct DB {
   QueryFunc& Func(Usr usr) { return funcs[func_usr[{usr}]]; }
   QueryType& Type(Usr usr) { return types[type_usr[{usr}]]; }
   QueryVar& Var(Usr usr) { return vars[var_usr[{usr}]]; }
+  QueryFunc& Func(DenseId id) { return funcs[uint32_t(id)]; }
+  QueryType& Type(DenseId id) { return types[uint32_t(id)]; }
+  QueryVar& Var(DenseId id) { return vars[uint32_t(id)]; }
+  // Returns the index of |usr|, creating an empty entity if it is unknown.
+  DenseId FuncId(Usr usr);
+  DenseId TypeId(Usr usr);
+  DenseId VarId(Usr usr);
 
   QueryFile& GetFile(SymbolIdx ref) { return files[ref.usr]; }
   QueryFunc& GetFunc(SymbolIdx ref) { return Func(ref.usr); }
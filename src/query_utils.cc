@@ -3,6 +3,7 @@
 #include "pipeline.hh"
 
 #include <limits.h>
+#include <numeric>
 #include <unordered_set>
 
 namespace {
@@ -14,24 +15,70 @@ int ComputeRangeSize(const Range& range) {
   return range.end.column - range.start.column;
 }
 
-template <typename Q>
-std::vector<Use> GetDeclarations(llvm::DenseMap<WrappedUsr, int>& entity_usr,
-                                 std::vector<Q>& entities,
-                                 const std::vector<Usr>& usrs) {
-  std::vector<Use> ret;
-  ret.reserve(usrs.size());
-  for (Usr usr : usrs) {
-    Q& entity = entities[entity_usr[{usr}]];
+// Calls |fn| with the defining declaration (if exists) or an arbitrary
+// declaration (otherwise) of each element of |ids|. |get| maps an element of
+// |ids| to the entity.
+template <typename Id, typename Get, typename Fn>
+void EachDeclaration(const std::vector<Id>& ids, Get get, Fn fn) {
+  for (Id id : ids) {
+    auto& entity = get(id);
     bool has_def = false;
     for (auto& def : entity.def)
       if (def.spell) {
-        ret.push_back(*def.spell);
+        fn(*def.spell);
         has_def = true;
         break;
       }
     if (!has_def && entity.declarations.size())
-      ret.push_back(entity.declarations[0]);
+      fn(entity.declarations[0]);
+  }
+}
+
+template <typename Id, typename Get>
+std::vector<Use> GetDeclarations(const std::vector<Id>& ids, Get get) {
+  std::vector<Use> ret;
+  ret.reserve(ids.size());
+  EachDeclaration(ids, get, [&](Use use) { ret.push_back(use); });
+  return ret;
+}
+
+// Like EachDeclaration, but skips variables whose definition kind is not
+// selected by |kind|.
+template <typename Id, typename Fn>
+void EachVarDeclaration(DB* db, const std::vector<Id>& ids, unsigned kind,
+                        Fn fn) {
+  for (Id id : ids) {
+    QueryVar& var = db->Var(id);
+    bool has_def = false;
+    for (auto& def : var.def)
+      if (def.spell) {
+        has_def = true;
+        // See messages/ccls_vars.cc
+        if (def.kind == lsSymbolKind::Field) {
+          if (!(kind & 1))
+            break;
+        } else if (def.kind == lsSymbolKind::Variable) {
+          if (!(kind & 2))
+            break;
+        } else if (def.kind == lsSymbolKind::Parameter) {
+          if (!(kind & 4))
+            break;
+        }
+        fn(*def.spell);
+        break;
+      }
+    if (!has_def && var.declarations.size())
+      fn(var.declarations[0]);
   }
+}
+
+template <typename Id>
+std::vector<Use> GetVarDeclarationsImpl(DB* db,
+                                        const std::vector<Id>& ids,
+                                        unsigned kind) {
+  std::vector<Use> ret;
+  ret.reserve(ids.size());
+  EachVarDeclaration(db, ids, kind, [&](Use use) { ret.push_back(use); });
   return ret;
 }
 
@@ -54,40 +101,56 @@ Maybe<Use> GetDefinitionExtent(DB* db, SymbolIdx sym) {
 }
 
 std::vector<Use> GetFuncDeclarations(DB* db, const std::vector<Usr>& usrs) {
-  return GetDeclarations(db->func_usr, db->funcs, usrs);
+  return GetDeclarations(usrs,
+                         [&](Usr usr) -> QueryFunc& { return db->Func(usr); });
+}
+std::vector<Use> GetFuncDeclarations(DB* db, const std::vector<DenseId>& ids) {
+  return GetDeclarations(ids,
+                         [&](DenseId id) -> QueryFunc& { return db->Func(id); });
 }
 std::vector<Use> GetTypeDeclarations(DB* db, const std::vector<Usr>& usrs) {
-  return GetDeclarations(db->type_usr, db->types, usrs);
+  return GetDeclarations(usrs,
+                         [&](Usr usr) -> QueryType& { return db->Type(usr); });
+}
+std::vector<Use> GetTypeDeclarations(DB* db, const std::vector<DenseId>& ids) {
+  return GetDeclarations(ids,
+                         [&](DenseId id) -> QueryType& { return db->Type(id); });
 }
 std::vector<Use> GetVarDeclarations(DB* db,
                                     const std::vector<Usr>& usrs,
                                     unsigned kind) {
-  std::vector<Use> ret;
-  ret.reserve(usrs.size());
-  for (Usr usr : usrs) {
-    QueryVar& var = db->Var(usr);
-    bool has_def = false;
-    for (auto& def : var.def)
-      if (def.spell) {
-        has_def = true;
-        // See messages/ccls_vars.cc
-        if (def.kind == lsSymbolKind::Field) {
-          if (!(kind & 1))
-            break;
-        } else if (def.kind == lsSymbolKind::Variable) {
-          if (!(kind & 2))
-            break;
-        } else if (def.kind == lsSymbolKind::Parameter) {
-          if (!(kind & 4))
-            break;
-        }
-        ret.push_back(*def.spell);
-        break;
-      }
-    if (!has_def && var.declarations.size())
-      ret.push_back(var.declarations[0]);
-  }
-  return ret;
+  return GetVarDeclarationsImpl(db, usrs, kind);
+}
+std::vector<Use> GetVarDeclarations(DB* db,
+                                    const std::vector<DenseId>& ids,
+                                    unsigned kind) {
+  return GetVarDeclarationsImpl(db, ids, kind);
+}
+
+size_t CountFuncDeclarations(DB* db, const std::vector<Usr>& usrs) {
+  size_t n = 0;
+  EachDeclaration(usrs, [&](Usr usr) -> QueryFunc& { return db->Func(usr); },
+                  [&](Use) { n++; });
+  return n;
+}
+size_t CountFuncDeclarations(DB* db, const std::vector<DenseId>& ids) {
+  size_t n = 0;
+  EachDeclaration(ids, [&](DenseId id) -> QueryFunc& { return db->Func(id); },
+                  [&](Use) { n++; });
+  return n;
+}
+size_t CountTypeDeclarations(DB* db, const std::vector<DenseId>& ids) {
+  size_t n = 0;
+  EachDeclaration(ids, [&](DenseId id) -> QueryType& { return db->Type(id); },
+                  [&](Use) { n++; });
+  return n;
+}
+size_t CountVarDeclarations(DB* db,
+                            const std::vector<DenseId>& ids,
+                            unsigned kind) {
+  size_t n = 0;
+  EachVarDeclaration(db, ids, kind, [&](Use) { n++; });
+  return n;
 }
 
 std::vector<Use> GetNonDefDeclarations(DB* db, SymbolIdx sym) {
@@ -103,45 +166,73 @@ std::vector<Use> GetNonDefDeclarations(DB* db, SymbolIdx sym) {
   }
 }
 
-std::vector<Use> GetUsesForAllBases(DB* db, QueryFunc& root) {
+namespace {
+std::vector<Use> GetUsesForAll(DB* db, QueryFunc& root, bool derived) {
   std::vector<Use> ret;
-  std::vector<QueryFunc*> stack{&root};
-  std::unordered_set<Usr> seen;
-  seen.insert(root.usr);
-  while (!stack.empty()) {
-    QueryFunc& func = *stack.back();
-    stack.pop_back();
-    if (auto* def = func.AnyDef()) {
-      EachDefinedFunc(db, def->bases, [&](QueryFunc& func1) {
-        if (!seen.count(func1.usr)) {
-          seen.insert(func1.usr);
-          stack.push_back(&func1);
-          ret.insert(ret.end(), func1.uses.begin(), func1.uses.end());
-        }
-      });
-    }
+  for (DenseId id :
+       db->GetClosure(SymbolKind::Func, db->FuncId(root.usr), derived)) {
+    QueryFunc& func = db->Func(id);
+    if (!func.def.empty())
+      ret.insert(ret.end(), func.uses.begin(), func.uses.end());
   }
-
   return ret;
 }
+size_t CountUsesForAll(DB* db, QueryFunc& root, bool derived) {
+  size_t n = 0;
+  for (DenseId id :
+       db->GetClosure(SymbolKind::Func, db->FuncId(root.usr), derived)) {
+    QueryFunc& func = db->Func(id);
+    if (!func.def.empty())
+      n += func.uses.size();
+  }
+  return n;
+}
+}  // namespace
+
+std::vector<Use> GetUsesForAllBases(DB* db, QueryFunc& root) {
+  return GetUsesForAll(db, root, false);
+}
 
 std::vector<Use> GetUsesForAllDerived(DB* db, QueryFunc& root) {
-  std::vector<Use> ret;
-  std::vector<QueryFunc*> stack{&root};
-  std::unordered_set<Usr> seen;
-  seen.insert(root.usr);
-  while (!stack.empty()) {
-    QueryFunc& func = *stack.back();
-    stack.pop_back();
-    EachDefinedFunc(db, func.derived, [&](QueryFunc& func1) {
-      if (!seen.count(func1.usr)) {
-        seen.insert(func1.usr);
-        stack.push_back(&func1);
-        ret.insert(ret.end(), func1.uses.begin(), func1.uses.end());
+  return GetUsesForAll(db, root, true);
+}
+
+size_t CountUsesForAllBases(DB* db, QueryFunc& root) {
+  return CountUsesForAll(db, root, false);
+}
+
+size_t CountUsesForAllDerived(DB* db, QueryFunc& root) {
+  return CountUsesForAll(db, root, true);
+}
+
+std::vector<Usr> GetTransitiveCalls(DB* db, Usr root, bool callee, int depth,
+                                    size_t limit) {
+  std::vector<Usr> ret, level{root}, next;
+  std::unordered_set<Usr> seen{root};
+  auto visit = [&](Usr usr) {
+    if (ret.size() < limit && db->HasFunc(usr) && seen.insert(usr).second) {
+      ret.push_back(usr);
+      next.push_back(usr);
+    }
+  };
+  for (int i = 0; i < depth && level.size() && ret.size() < limit; i++) {
+    for (Usr usr : level) {
+      QueryFunc& func = db->Func(usr);
+      if (callee) {
+        if (const auto* def = func.AnyDef())
+          for (SymbolRef ref : def->callees)
+            if (ref.kind == SymbolKind::Func)
+              visit(ref.usr);
+      } else {
+        // The lexical parent of a call is the calling function.
+        for (Use use : func.uses)
+          if (use.kind == SymbolKind::Func)
+            visit(use.usr);
       }
-    });
+    }
+    level.swap(next);
+    next.clear();
   }
-
   return ret;
 }
 
@@ -226,8 +317,13 @@ std::optional<lsLocationEx> GetLsLocationEx(DB* db,
   std::optional<lsLocation> ls_loc = GetLsLocation(db, working_files, use);
   if (!ls_loc)
     return std::nullopt;
+  return GetLsLocationEx(db, use, *ls_loc, container);
+}
+
+lsLocationEx GetLsLocationEx(DB* db, Use use, const lsLocation& loc,
+                             bool container) {
   lsLocationEx ret;
-  ret.lsLocation::operator=(*ls_loc);
+  ret.lsLocation::operator=(loc);
   if (container) {
     ret.role = uint16_t(use.role);
     EachEntityDef(db, use, [&](const auto& def) {
@@ -238,14 +334,41 @@ std::optional<lsLocationEx> GetLsLocationEx(DB* db,
   return ret;
 }
 
+std::vector<std::optional<lsLocation>>
+GetLsLocations(DB* db, WorkingFiles* working_files,
+               const std::vector<Use>& uses) {
+  std::vector<std::optional<lsLocation>> ret(uses.size());
+  // Group by file so that each file is resolved once.
+  std::vector<int> order(uses.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int l, int r) {
+    return uses[l].file_id < uses[r].file_id;
+  });
+  std::string path;
+  lsDocumentUri uri;
+  WorkingFile* wfile = nullptr;
+  for (size_t i = 0; i < order.size(); i++) {
+    const Use& use = uses[order[i]];
+    if (i == 0 || use.file_id != uses[order[i - 1]].file_id) {
+      uri = GetLsDocumentUri(db, use.file_id, &path);
+      wfile = working_files->GetFileByFilename(path);
+    }
+    if (std::optional<lsRange> range = GetLsRange(wfile, use.range))
+      ret[order[i]] = lsLocation{uri, *range};
+  }
+  return ret;
+}
+
 std::vector<lsLocationEx> GetLsLocationExs(DB* db,
                                            WorkingFiles* working_files,
                                            const std::vector<Use>& uses) {
   std::vector<lsLocationEx> ret;
-  for (Use use : uses)
-    if (auto loc =
-            GetLsLocationEx(db, working_files, use, g_config->xref.container))
-      ret.push_back(*loc);
+  std::vector<std::optional<lsLocation>> locs =
+      GetLsLocations(db, working_files, uses);
+  for (size_t i = 0; i < uses.size(); i++)
+    if (locs[i])
+      ret.push_back(
+          GetLsLocationEx(db, uses[i], *locs[i], g_config->xref.container));
   std::sort(ret.begin(), ret.end());
   ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
   if (ret.size() > g_config->xref.maxNum)
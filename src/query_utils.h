@@ -11,14 +11,30 @@ Maybe<Use> GetDefinitionExtent(DB* db, SymbolIdx sym);
 // Get defining declaration (if exists) or an arbitrary declaration (otherwise)
 // for each id.
 std::vector<Use> GetFuncDeclarations(DB*, const std::vector<Usr>&);
+std::vector<Use> GetFuncDeclarations(DB*, const std::vector<DenseId>&);
 std::vector<Use> GetTypeDeclarations(DB*, const std::vector<Usr>&);
+std::vector<Use> GetTypeDeclarations(DB*, const std::vector<DenseId>&);
 std::vector<Use> GetVarDeclarations(DB*, const std::vector<Usr>&, unsigned);
+std::vector<Use> GetVarDeclarations(DB*, const std::vector<DenseId>&, unsigned);
+// The sizes of the corresponding Get*Declarations results, without building
+// them.
+size_t CountFuncDeclarations(DB*, const std::vector<Usr>&);
+size_t CountFuncDeclarations(DB*, const std::vector<DenseId>&);
+size_t CountTypeDeclarations(DB*, const std::vector<DenseId>&);
+size_t CountVarDeclarations(DB*, const std::vector<DenseId>&, unsigned);
 
 // Get non-defining declarations.
 std::vector<Use> GetNonDefDeclarations(DB* db, SymbolIdx sym);
 
 std::vector<Use> GetUsesForAllBases(DB* db, QueryFunc& root);
 std::vector<Use> GetUsesForAllDerived(DB* db, QueryFunc& root);
+size_t CountUsesForAllBases(DB* db, QueryFunc& root);
+size_t CountUsesForAllDerived(DB* db, QueryFunc& root);
+// Functions which reach |root| in 1 to |depth| calls (or, if |callee|, are
+// reached from it), in breadth-first order, at most |limit| of them. Calls are
+// read from uses and Def::callees, as in $ccls/callHierarchy.
+std::vector<Usr> GetTransitiveCalls(DB* db, Usr root, bool callee, int depth,
+                                    size_t limit);
 std::optional<lsPosition> GetLsPosition(WorkingFile* working_file,
                                         const Position& position);
 std::optional<lsRange> GetLsRange(WorkingFile* working_file,
@@ -33,6 +49,13 @@ std::optional<lsLocationEx> GetLsLocationEx(DB* db,
                                             WorkingFiles* working_files,
                                             Use use,
                                             bool container);
+lsLocationEx GetLsLocationEx(DB* db, Use use, const lsLocation& loc,
+                             bool container);
+// Bulk version of GetLsLocation. The document and working file of each file
+// are looked up only once. ret[i] corresponds to uses[i].
+std::vector<std::optional<lsLocation>>
+GetLsLocations(DB* db, WorkingFiles* working_files,
+               const std::vector<Use>& uses);
 std::vector<lsLocationEx> GetLsLocationExs(DB* db,
                                            WorkingFiles* working_files,
                                            const std::vector<Use>& refs);
@@ -90,29 +113,32 @@ void EachOccurrence(DB* db, SymbolIdx sym, bool include_decl, Fn&& fn) {
 
 lsSymbolKind GetSymbolKind(DB* db, SymbolIdx sym);
 
-template <typename Fn>
-void EachDefinedFunc(DB* db, const std::vector<Usr>& usrs, Fn&& fn) {
-  for (Usr usr : usrs) {
-    auto& obj = db->Func(usr);
+// |ids| may contain Usr or DenseId.
+template <typename Id, typename Fn>
+void EachDefinedFunc(DB* db, const std::vector<Id>& ids, Fn&& fn) {
+  for (Id id : ids) {
+    auto& obj = db->Func(id);
     if (!obj.def.empty())
       fn(obj);
   }
 }
 
 
-template <typename Fn>
-void EachDefinedType(DB* db, const std::vector<Usr>& usrs, Fn&& fn) {
-  for (Usr usr : usrs) {
-    auto& obj = db->Type(usr);
+// |ids| may contain Usr or DenseId.
+template <typename Id, typename Fn>
+void EachDefinedType(DB* db, const std::vector<Id>& ids, Fn&& fn) {
+  for (Id id : ids) {
+    auto& obj = db->Type(id);
     if (!obj.def.empty())
       fn(obj);
   }
 }
 
-template <typename Fn>
-void EachDefinedVar(DB* db, const std::vector<Usr>& usrs, Fn&& fn) {
-  for (Usr usr : usrs) {
-    auto& obj = db->Var(usr);
+// |ids| may contain Usr or DenseId.
+template <typename Id, typename Fn>
+void EachDefinedVar(DB* db, const std::vector<Id>& ids, Fn&& fn) {
+  for (Id id : ids) {
+    auto& obj = db->Var(id);
     if (!obj.def.empty())
       fn(obj);
   }
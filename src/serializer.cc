@@ -8,9 +8,14 @@
 
 #include <llvm/ADT/CachedHashString.h>
 #include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Support/Allocator.h>
 
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
+#include <unordered_set>
 
 using namespace llvm;
 
@@ -151,9 +156,9 @@ void Reflect(Writer& visitor, JsonNull& value) {
   visitor.Null();
 }
 
-// std::unordered_map
+// UsrMap
 template <typename V>
-void Reflect(Reader& visitor, std::unordered_map<Usr, V>& map) {
+void Reflect(Reader& visitor, UsrMap<V>& map) {
   visitor.IterArray([&](Reader& entry) {
     V val;
     Reflect(entry, val);
@@ -162,13 +167,16 @@ void Reflect(Reader& visitor, std::unordered_map<Usr, V>& map) {
   });
 }
 template <typename V>
-void Reflect(Writer& visitor, std::unordered_map<Usr, V>& map) {
-  std::vector<std::pair<uint64_t, V>> xs(map.begin(), map.end());
+void Reflect(Writer& visitor, UsrMap<V>& map) {
+  std::vector<V*> xs;
+  xs.reserve(map.size());
+  for (V& x : map)
+    xs.push_back(&x);
   std::sort(xs.begin(), xs.end(),
-            [](const auto& a, const auto& b) { return a.first < b.first; });
+            [](const V* a, const V* b) { return a->usr < b->usr; });
   visitor.StartArray(xs.size());
-  for (auto& it : xs)
-    Reflect(visitor, it.second);
+  for (V* x : xs)
+    Reflect(visitor, *x);
   visitor.EndArray();
 }
 
@@ -376,18 +384,148 @@ void Reflect(Writer& visitor, SerializeFormat& value) {
 }
 
 namespace ccls {
-static BumpPtrAllocator Alloc;
-static DenseSet<StringRef> Strings;
-static std::mutex AllocMutex;
+namespace {
+// Interned strings are sharded by hash so that indexer threads and
+// Deserialize rarely contend on the same lock. Lookups of strings which are
+// already interned, the common case, only take a shared lock.
+constexpr unsigned kInternShards = 64;
+struct InternShard {
+  std::shared_mutex mutex;
+  BumpPtrAllocator Alloc;
+  DenseSet<CachedHashStringRef> Strings;
+};
+InternShard InternShards[kInternShards];
+// DenseSet probes from the low bits of the hash, so pick the shard from the
+// high bits. Otherwise all keys of a shard would start probing at the same
+// 1/kInternShards of the buckets.
+unsigned InternShardOf(const CachedHashStringRef &Str) {
+  static_assert(kInternShards == 64, "shard index takes 6 bits");
+  return Str.hash() >> 26;
+}
+std::atomic<uint64_t> InternLookups, InternMisses, InternBytes,
+    InternContended, InternLiveBytes;
+
+template <typename Lock> void LockCounted(Lock &lock) {
+  if (!lock.try_lock()) {
+    InternContended.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+  }
+}
+} // namespace
 
 const char* Intern(const std::string& str) {
   if (str.empty()) return "";
-  StringRef Str(str.data(), str.size() + 1);
-  std::lock_guard lock(AllocMutex);
-  auto R = Strings.insert(Str);
-  if (R.second)
-    *R.first = Str.copy(Alloc);
-  return R.first->data();
+  CachedHashStringRef Str(StringRef(str.data(), str.size() + 1));
+  InternShard &shard = InternShards[InternShardOf(Str)];
+  InternLookups.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::shared_lock lock(shard.mutex, std::defer_lock);
+    LockCounted(lock);
+    auto it = shard.Strings.find(Str);
+    if (it != shard.Strings.end())
+      return it->val().data();
+  }
+  std::unique_lock lock(shard.mutex, std::defer_lock);
+  LockCounted(lock);
+  auto R = shard.Strings.insert(Str);
+  if (R.second) {
+    *R.first = CachedHashStringRef(Str.val().copy(shard.Alloc), Str.hash());
+    InternMisses.fetch_add(1, std::memory_order_relaxed);
+    InternBytes.fetch_add(Str.size(), std::memory_order_relaxed);
+  }
+  return R.first->val().data();
+}
+
+namespace {
+struct ArgListHash {
+  size_t operator()(const std::vector<const char *> &args) const {
+    return hash_combine_range(args.begin(), args.end());
+  }
+};
+// Arguments are not stored with Intern, which CompactInterned may move.
+std::mutex ArgsMutex;
+BumpPtrAllocator ArgsAlloc;
+DenseSet<CachedHashStringRef> ArgStrings;
+std::unordered_set<std::vector<const char *>, ArgListHash> ArgLists;
+} // namespace
+
+CompileArgs::CompileArgs() {
+  // Use the interned empty list, so that all empty lists compare equal.
+  static const std::vector<const char *> *empty =
+      CompileArgs(std::vector<std::string>{}).args_;
+  args_ = empty;
+}
+
+CompileArgs::CompileArgs(const std::vector<std::string> &args) {
+  std::vector<const char *> list;
+  list.reserve(args.size());
+  std::lock_guard lock(ArgsMutex);
+  for (const std::string &arg : args) {
+    CachedHashStringRef Str(StringRef(arg.data(), arg.size() + 1));
+    auto R = ArgStrings.insert(Str);
+    if (R.second)
+      *R.first = CachedHashStringRef(Str.val().copy(ArgsAlloc), Str.hash());
+    list.push_back(R.first->val().data());
+  }
+  args_ = &*ArgLists.insert(std::move(list)).first;
+}
+
+void Reflect(Reader &vis, CompileArgs &v) {
+  std::vector<std::string> args;
+  ::Reflect(vis, args);
+  v = CompileArgs(args);
+}
+void Reflect(Writer &vis, CompileArgs &v) {
+  vis.StartArray(v.size());
+  for (const char *arg : v)
+    vis.String(arg);
+  vis.EndArray();
+}
+
+InternStats GetInternStats() {
+  InternStats stats;
+  stats.lookups = InternLookups.load(std::memory_order_relaxed);
+  stats.strings = InternMisses.load(std::memory_order_relaxed);
+  stats.bytes = InternBytes.load(std::memory_order_relaxed);
+  stats.live_bytes = InternLiveBytes.load(std::memory_order_relaxed);
+  stats.contended = InternContended.load(std::memory_order_relaxed);
+  return stats;
+}
+
+bool CompactInterned(
+    function_ref<bool()> idle,
+    function_ref<void(function_ref<void(const char *&)>)> visit) {
+  std::unique_lock<std::shared_mutex> locks[kInternShards];
+  for (unsigned i = 0; i < kInternShards; i++)
+    locks[i] = std::unique_lock(InternShards[i].mutex);
+  if (!idle())
+    return false;
+
+  // Copy live strings into a new generation, then drop the old one.
+  std::vector<BumpPtrAllocator> allocs(kInternShards);
+  std::vector<DenseSet<CachedHashStringRef>> sets(kInternShards);
+  uint64_t strings = 0, bytes = 0;
+  visit([&](const char *&str) {
+    if (!*str)
+      return;
+    CachedHashStringRef Str(StringRef(str, strlen(str) + 1));
+    unsigned i = InternShardOf(Str);
+    auto R = sets[i].insert(Str);
+    if (R.second) {
+      *R.first = CachedHashStringRef(Str.val().copy(allocs[i]), Str.hash());
+      strings++;
+      bytes += Str.size();
+    }
+    str = R.first->val().data();
+  });
+  for (unsigned i = 0; i < kInternShards; i++) {
+    InternShards[i].Alloc = std::move(allocs[i]);
+    InternShards[i].Strings = std::move(sets[i]);
+  }
+  InternMisses = strings;
+  InternBytes = bytes;
+  InternLiveBytes = bytes;
+  return true;
 }
 
 std::string Serialize(SerializeFormat format, IndexFile& file) {
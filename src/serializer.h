@@ -2,6 +2,7 @@
 
 #include "maybe.h"
 
+#include <llvm/ADT/STLExtras.h>
 #include <llvm/Support/Compiler.h>
 
 #include <macro_map.h>
@@ -323,6 +324,49 @@ void ReflectMember(Writer& vis, const char* name, T& v) {
 
 namespace ccls {
 const char* Intern(const std::string& str);
+struct InternStats {
+  // Calls to Intern, distinct strings and their total size.
+  uint64_t lookups = 0, strings = 0, bytes = 0;
+  // |bytes| after the last CompactInterned.
+  uint64_t live_bytes = 0;
+  // Lock acquisitions which had to wait for another thread.
+  uint64_t contended = 0;
+};
+InternStats GetInternStats();
+// Frees interned strings which are no longer referenced. Interning is blocked
+// while |idle| is checked; it must return true only if no other thread holds
+// interned strings. |visit| then applies its argument to every live interned
+// pointer, which is redirected to the new storage. Returns whether compaction
+// happened.
+bool CompactInterned(
+    llvm::function_ref<bool()> idle,
+    llvm::function_ref<void(llvm::function_ref<void(const char *&)>)> visit);
+
+// Compiler arguments of a translation unit. Lists are interned, so the copies
+// held by Project, index requests, IndexFile and QueryFile share one immutable
+// list, and equal arguments share storage across lists. Copying is a pointer
+// copy and == compares pointers. Interned lists are never freed.
+class CompileArgs {
+  const std::vector<const char *> *args_;
+
+public:
+  CompileArgs();
+  CompileArgs(const std::vector<std::string> &args);
+
+  using const_iterator = std::vector<const char *>::const_iterator;
+  const_iterator begin() const { return args_->begin(); }
+  const_iterator end() const { return args_->end(); }
+  size_t size() const { return args_->size(); }
+  bool empty() const { return args_->empty(); }
+  const char *operator[](size_t i) const { return (*args_)[i]; }
+  std::vector<std::string> ToVector() const { return {begin(), end()}; }
+
+  bool operator==(const CompileArgs &o) const { return args_ == o.args_; }
+  bool operator!=(const CompileArgs &o) const { return args_ != o.args_; }
+};
+void Reflect(Reader &vis, CompileArgs &v);
+void Reflect(Writer &vis, CompileArgs &v);
+
 std::string Serialize(SerializeFormat format, IndexFile& file);
 std::unique_ptr<IndexFile> Deserialize(
     SerializeFormat format,
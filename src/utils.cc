@@ -13,6 +13,7 @@ using namespace llvm;
 #include <string.h>
 #include <algorithm>
 #include <functional>
+#include <mutex>
 #include <unordered_map>
 using namespace std::placeholders;
 
@@ -137,6 +138,45 @@ std::optional<int64_t> LastWriteTime(const std::string& filename) {
   return Status.getLastModificationTime().time_since_epoch().count();
 }
 
+namespace {
+std::mutex write_times_mutex;
+std::unordered_map<std::string, std::optional<int64_t>> write_times;
+int64_t write_times_epoch;
+}
+
+void CachedLastWriteTimes(const std::vector<std::string>& paths,
+                          std::vector<std::optional<int64_t>>* times) {
+  times->assign(paths.size(), std::nullopt);
+  std::vector<size_t> misses;
+  int64_t epoch;
+  {
+    std::lock_guard<std::mutex> lock(write_times_mutex);
+    epoch = write_times_epoch;
+    for (size_t i = 0; i < paths.size(); i++) {
+      auto it = write_times.find(paths[i]);
+      if (it == write_times.end())
+        misses.push_back(i);
+      else
+        (*times)[i] = it->second;
+    }
+  }
+  if (misses.empty())
+    return;
+  for (size_t i : misses)
+    (*times)[i] = LastWriteTime(paths[i]);
+  // Results of stats which started before an invalidation may be stale.
+  std::lock_guard<std::mutex> lock(write_times_mutex);
+  if (epoch == write_times_epoch)
+    for (size_t i : misses)
+      write_times.emplace(paths[i], (*times)[i]);
+}
+
+void InvalidateWriteTimes() {
+  std::lock_guard<std::mutex> lock(write_times_mutex);
+  write_times_epoch++;
+  write_times.clear();
+}
+
 // Find discontinous |search| in |content|.
 // Return |found| and the count of skipped chars before found.
 int ReverseSubseqMatch(std::string_view pat,
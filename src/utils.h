@@ -62,6 +62,14 @@ std::string EscapeFileName(std::string path);
 std::optional<std::string> ReadContent(const std::string& filename);
 void WriteToFile(const std::string& filename, const std::string& content);
 std::optional<int64_t> LastWriteTime(const std::string& filename);
+// LastWriteTime of each of |paths|, through a cache shared by all threads.
+// Results are reused until InvalidateWriteTimes starts a new epoch, so a
+// header included by many translation units is stat'ed once per epoch. Only
+// meant for the initial load of a project; InvalidateWriteTimes is called
+// when it finishes.
+void CachedLastWriteTimes(const std::vector<std::string>& paths,
+                          std::vector<std::optional<int64_t>>* times);
+void InvalidateWriteTimes();
 
 int ReverseSubseqMatch(std::string_view pat,
                        std::string_view text,
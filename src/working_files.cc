@@ -16,6 +16,9 @@ constexpr int kMaxDiff = 20;
 // Don't align index line to buffer line if one of the lengths is larger than
 // |kMaxColumnAlignSize|.
 constexpr int kMaxColumnAlignSize = 200;
+// Recompute line mappings from scratch if more than this many lines (or 1/8 of
+// the file) have been edited since the last computation.
+constexpr int kMaxStaleLines = 64;
 
 lsPosition GetPositionForOffset(const std::string& content, int offset) {
   if (offset >= content.size())
@@ -204,19 +207,131 @@ WorkingFile::WorkingFile(const std::string& filename,
 }
 
 void WorkingFile::SetIndexContent(const std::string& index_content) {
-  index_lines = ToLines(index_content);
-
-  index_to_buffer.clear();
-  buffer_to_index.clear();
+  std::vector<std::string> lines = ToLines(index_content);
+  // The new index content usually differs from the old one in a few places.
+  // Keep the mappings of the common prefix and suffix.
+  int n = index_lines.size(), m = lines.size(), head = 0, tail = 0;
+  if (!index_to_buffer.empty()) {
+    while (head < n && head < m && index_lines[head] == lines[head])
+      head++;
+    while (tail < n - head && tail < m - head &&
+           index_lines[n - 1 - tail] == lines[m - 1 - tail])
+      tail++;
+  }
+  index_lines = std::move(lines);
+  SpliceLineMapping(true, head, n - tail, m - head - tail);
 }
 
 void WorkingFile::OnBufferContentUpdated() {
   buffer_lines = ToLines(buffer_content);
+  line_offsets.assign(1, 0);
+  for (size_t i = 0; i < buffer_content.size(); i++)
+    if (buffer_content[i] == '\n')
+      line_offsets.push_back(int(i + 1));
+  shared_content_.reset();
+  buffer_generation++;
 
   index_to_buffer.clear();
   buffer_to_index.clear();
 }
 
+void WorkingFile::ReplaceRange(const lsRange& range, const std::string& text) {
+  int start_offset = GetOffsetForPosition(range.start);
+  // Ignore TextDocumentContentChangeEvent.rangeLength which causes trouble
+  // when UTF-16 surrogate pairs are used.
+  int end_offset = std::max(start_offset, GetOffsetForPosition(range.end));
+  // Lines [l0, l1] are touched by the edit.
+  int l0 = int(std::upper_bound(line_offsets.begin(), line_offsets.end(),
+                                start_offset) -
+               line_offsets.begin()) - 1,
+      l1 = int(std::upper_bound(line_offsets.begin(), line_offsets.end(),
+                                end_offset) -
+               line_offsets.begin()) - 1;
+  buffer_content.replace(start_offset, end_offset - start_offset, text);
+
+  std::vector<int> inserted;
+  for (size_t i = 0; i < text.size(); i++)
+    if (text[i] == '\n')
+      inserted.push_back(start_offset + int(i + 1));
+  int delta = int(text.size()) - (end_offset - start_offset);
+  for (auto it = line_offsets.begin() + l1 + 1; it != line_offsets.end(); ++it)
+    *it += delta;
+  line_offsets.erase(line_offsets.begin() + l0 + 1,
+                     line_offsets.begin() + l1 + 1);
+  line_offsets.insert(line_offsets.begin() + l0 + 1, inserted.begin(),
+                      inserted.end());
+
+  // Like ToLines, the line after a trailing '\n' does not count.
+  int num_lines = int(line_offsets.size());
+  if (line_offsets.back() == int(buffer_content.size()))
+    num_lines--;
+  std::vector<std::string> lines;
+  for (int i = l0; i <= l0 + int(inserted.size()) && i < num_lines; i++) {
+    int end = i + 1 < int(line_offsets.size()) ? line_offsets[i + 1] - 1
+                                                : int(buffer_content.size());
+    lines.push_back(buffer_content.substr(line_offsets[i], end - line_offsets[i]));
+  }
+  int old_lines = int(buffer_lines.size()), begin = std::min(l0, old_lines),
+      end = std::min(l1 + 1, old_lines), count = int(lines.size());
+  buffer_lines.erase(buffer_lines.begin() + begin, buffer_lines.begin() + end);
+  buffer_lines.insert(buffer_lines.begin() + begin,
+                      std::make_move_iterator(lines.begin()),
+                      std::make_move_iterator(lines.end()));
+  shared_content_.reset();
+  buffer_generation++;
+  SpliceLineMapping(false, begin, end, count);
+}
+
+void WorkingFile::SpliceLineMapping(bool index, int begin, int end, int count) {
+  std::vector<int>& from = index ? index_to_buffer : buffer_to_index;
+  std::vector<int>& to = index ? buffer_to_index : index_to_buffer;
+  auto& from_lines = index ? index_lines : buffer_lines;
+  auto& to_lines = index ? buffer_lines : index_lines;
+  // The lines of |from| have already been spliced. If either mapping is
+  // absent or out of sync (e.g. the index was empty), drop both and let the
+  // next lookup recompute them.
+  if (from.empty() || to.empty() || int(from.size()) < end ||
+      to.size() != to_lines.size() ||
+      from.size() - (end - begin) + count != from_lines.size()) {
+    index_to_buffer.clear();
+    buffer_to_index.clear();
+    return;
+  }
+  stale_lines_ += count;
+  if (stale_lines_ >
+      std::max(kMaxStaleLines,
+               int(std::max(index_lines.size(), buffer_lines.size())) / 8)) {
+    index_to_buffer.clear();
+    buffer_to_index.clear();
+    return;
+  }
+  int delta = count - (end - begin);
+  for (int& j : to)
+    if (j >= end)
+      j += delta;
+    else if (j >= begin)
+      j = -1;
+  from.erase(from.begin() + begin, from.begin() + end);
+  from.insert(from.begin() + begin, count, -1);
+}
+
+int WorkingFile::GetOffsetForPosition(lsPosition position) const {
+  if (position.line < 0)
+    return 0;
+  if (position.line >= int(line_offsets.size()))
+    return int(buffer_content.size());
+  int offset = line_offsets[position.line];
+  return offset + ::GetOffsetForPosition(
+                      {0, position.character},
+                      std::string_view(buffer_content).substr(offset));
+}
+
+std::shared_ptr<const std::string> WorkingFile::GetSharedContent() {
+  if (!shared_content_)
+    shared_content_ = std::make_shared<const std::string>(buffer_content);
+  return shared_content_;
+}
+
 // Variant of Paul Heckel's diff algorithm to compute |index_to_buffer| and
 // |buffer_to_index|.
 // The core idea is that if a line is unique in both index and buffer,
@@ -224,6 +339,7 @@ void WorkingFile::OnBufferContentUpdated() {
 // buffer. And then using them as start points to extend upwards and downwards
 // to align other identical lines (but not unique).
 void WorkingFile::ComputeLineMapping() {
+  stale_lines_ = 0;
   std::unordered_map<uint64_t, int> hash_to_unique;
   std::vector<uint64_t> index_hashes(index_lines.size());
   std::vector<uint64_t> buffer_hashes(buffer_lines.size());
@@ -334,7 +450,7 @@ std::string WorkingFile::FindClosestCallNameInBuffer(
     lsPosition* completion_position) const {
   *active_parameter = 0;
 
-  int offset = GetOffsetForPosition(position, buffer_content);
+  int offset = GetOffsetForPosition(position);
 
   // If vscode auto-inserts closing ')' we will begin on ')' token in foo()
   // which will make the below algorithm think it's a nested call.
@@ -384,7 +500,7 @@ lsPosition WorkingFile::FindStableCompletionSource(
     lsPosition* replace_end_pos) const {
   *is_global_completion = true;
 
-  int start_offset = GetOffsetForPosition(position, buffer_content);
+  int start_offset = GetOffsetForPosition(position);
   int offset = start_offset;
 
   while (offset > 0) {
@@ -426,11 +542,8 @@ WorkingFile* WorkingFiles::GetFileByFilename(const std::string& filename) {
 
 WorkingFile* WorkingFiles::GetFileByFilenameNoLock(
     const std::string& filename) {
-  for (auto& file : files) {
-    if (file->filename == filename)
-      return file.get();
-  }
-  return nullptr;
+  auto it = files.find(filename);
+  return it == files.end() ? nullptr : it->second.get();
 }
 
 void WorkingFiles::DoAction(const std::function<void()>& action) {
@@ -457,11 +570,14 @@ WorkingFile* WorkingFiles::OnOpen(const lsTextDocumentItem& open) {
     file->version = open.version;
     file->buffer_content = content;
     file->OnBufferContentUpdated();
+    // The client has dropped the highlighting of the closed document.
+    file->semantic_highlight_hash = 0;
     return file;
   }
 
-  files.push_back(std::make_unique<WorkingFile>(filename, content));
-  return files[files.size() - 1].get();
+  auto& file = files[filename];
+  file = std::make_unique<WorkingFile>(filename, content);
+  return file.get();
 }
 
 void WorkingFiles::OnChange(const lsTextDocumentDidChangeParams& change) {
@@ -486,16 +602,7 @@ void WorkingFiles::OnChange(const lsTextDocumentDidChangeParams& change) {
       file->buffer_content = diff.text;
       file->OnBufferContentUpdated();
     } else {
-      int start_offset =
-          GetOffsetForPosition(diff.range->start, file->buffer_content);
-      // Ignore TextDocumentContentChangeEvent.rangeLength which causes trouble
-      // when UTF-16 surrogate pairs are used.
-      int end_offset =
-          GetOffsetForPosition(diff.range->end, file->buffer_content);
-      file->buffer_content.replace(file->buffer_content.begin() + start_offset,
-                                   file->buffer_content.begin() + end_offset,
-                                   diff.text);
-      file->OnBufferContentUpdated();
+      file->ReplaceRange(*diff.range, diff.text);
     }
   }
 }
@@ -505,12 +612,8 @@ void WorkingFiles::OnClose(const lsTextDocumentIdentifier& close) {
 
   std::string filename = close.uri.GetPath();
 
-  for (int i = 0; i < files.size(); ++i) {
-    if (files[i]->filename == filename) {
-      files.erase(files.begin() + i);
-      return;
-    }
-  }
+  if (files.erase(filename))
+    return;
 
   LOG_S(WARNING) << "Could not close " << filename
                  << " because it was not open";
@@ -522,9 +625,9 @@ WorkingFiles::Snapshot WorkingFiles::AsSnapshot(
 
   Snapshot result;
   result.files.reserve(files.size());
-  for (const auto& file : files) {
+  for (const auto& [_, file] : files) {
     if (filter_paths.empty() || FindAnyPartial(file->filename, filter_paths))
-      result.files.push_back({file->filename, file->buffer_content});
+      result.files.push_back({file->filename, file->GetSharedContent()});
   }
   return result;
 }
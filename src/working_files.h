@@ -3,9 +3,11 @@
 #include "lsp_diagnostic.h"
 #include "utils.h"
 
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 
 struct WorkingFile {
   int version = 0;
@@ -16,6 +18,9 @@ struct WorkingFile {
   std::vector<std::string> index_lines;
   // Note: This assumes 0-based lines (1-based lines are normally assumed).
   std::vector<std::string> buffer_lines;
+  // Offset in |buffer_content| of the start of each line. There is one more
+  // entry than the number of '\n' in |buffer_content|.
+  std::vector<int> line_offsets;
   // Mappings between index line number and buffer line number.
   // Empty indicates either buffer or index has been changed and re-computation
   // is required.
@@ -28,6 +33,13 @@ struct WorkingFile {
   // NOTE: _ is appended because it must be accessed under the WorkingFiles
   // lock!
   std::vector<lsDiagnostic> diagnostics_;
+  // Incremented whenever |buffer_content| changes. Unlike |version|, it does
+  // not depend on the client.
+  int buffer_generation = 0;
+  // Hash of the symbols and |buffer_generation| from which the last semantic
+  // highlighting of this file was computed. If neither has changed, it is
+  // neither recomputed nor sent again.
+  size_t semantic_highlight_hash = 0;
 
   WorkingFile(const std::string& filename, const std::string& buffer_content);
 
@@ -35,6 +47,14 @@ struct WorkingFile {
   void SetIndexContent(const std::string& index_content);
   // This should be called whenever |buffer_content| has changed.
   void OnBufferContentUpdated();
+  // Replaces |range| of |buffer_content| with |text|. |line_offsets| and
+  // |buffer_lines| are updated for the affected lines only.
+  void ReplaceRange(const lsRange& range, const std::string& text);
+  // Like ::GetOffsetForPosition, but seeks to the line with |line_offsets|.
+  int GetOffsetForPosition(lsPosition position) const;
+  // Returns an immutable copy of |buffer_content| shared by all snapshots of
+  // the current version. It is created on first use after each change.
+  std::shared_ptr<const std::string> GetSharedContent();
 
   // Finds the buffer line number which maps to index line number |line|.
   // Also resolves |column| if not NULL.
@@ -73,13 +93,24 @@ struct WorkingFile {
  private:
   // Compute index_to_buffer and buffer_to_index.
   void ComputeLineMapping();
+  // Called after lines [begin, end) of |index_lines| (if |index|) or
+  // |buffer_lines| have been replaced by |count| lines. Shifts the line
+  // mappings and marks the replaced lines as unconfident, or drops the
+  // mappings if too many lines have become unconfident.
+  void SpliceLineMapping(bool index, int begin, int end, int count);
+  // Number of lines marked unconfident by SpliceLineMapping since the last
+  // ComputeLineMapping.
+  int stale_lines_ = 0;
+
+  std::shared_ptr<const std::string> shared_content_;
 };
 
 struct WorkingFiles {
   struct Snapshot {
     struct File {
       std::string filename;
-      std::string content;
+      // Shared with the WorkingFile and other snapshots of the same version.
+      std::shared_ptr<const std::string> content;
     };
 
     std::vector<File> files;
@@ -109,9 +140,9 @@ struct WorkingFiles {
   // string "foo" or "bar" contained within it.
   Snapshot AsSnapshot(const std::vector<std::string>& filter_paths);
 
-  // Use unique_ptrs so we can handout WorkingFile ptrs and not have them
-  // invalidated if we resize files.
-  std::vector<std::unique_ptr<WorkingFile>> files;
+  // Keyed by filename. Use unique_ptrs so we can handout WorkingFile ptrs and
+  // not have them invalidated on rehash.
+  std::unordered_map<std::string, std::unique_ptr<WorkingFile>> files;
   std::mutex files_mutex;  // Protects |files|.
 };
 